@@ -0,0 +1,12 @@
+# Turns a SPIR-V binary into a header with a uint32_t array, so shaders don't need to be loaded from disk.
+# Usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DNAME=<ARRAY_NAME> -P EmbedShader.cmake
+file(READ ${INPUT} SPIRV HEX)
+
+# SPIR-V is a stream of little endian words
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," WORDS ${SPIRV})
+
+file(WRITE ${OUTPUT}
+        "// Generated from ${INPUT}. Do not edit.\n"
+        "#pragma once\n"
+        "#include <cstdint>\n"
+        "static const uint32_t ${NAME}[] = {${WORDS}};\n")
@@ -11,16 +11,20 @@
 #include "io/window_manager.h"
 #include "io/input_manager.h"
 #include "ecs/ecs.h"
+#include "ecs/scheduler.h"
 #include "io/printer.h"
 
 #include <memory>
 #include <string>
+#include <future>
 
 class Application {
 public:
     void run();
 
     std::string title;
+    // MeshGenerators spec that replaces the dense sphere, if not empty
+    std::string generatedMeshSpec;
 private:
     void init();
 
@@ -28,18 +32,38 @@ private:
 
     void destroy();
 
+    // Starts loading the other mesh in the background. Device, swapchain and pipelines stay untouched.
+    void switchMesh();
+
+    // Imports the main mesh on a background thread, the current main mesh stays visible meanwhile
+    void loadMainMesh();
+
+    // Replaces the main mesh entity once loading is done
+    void finishLoadingMainMesh();
+
+    // Registers the systems that run on the scheduler, with the components they access
+    void createSystems();
+
+    static inline Query QueryInstances{signatureOf<MeshInstance>()};
+
     ECS ecs{};
+    Scheduler scheduler{};
     Renderer renderer{};
     WindowManager windowManager{};
     InputController inputManager{};
 
     chrono_sec_point lastTimestamp = Timer::now();
+    chrono_sec_point initTimestamp = Timer::now();
+    sec timeToFirstFrame = 0;
+    sec timeToInteractive = 0;
     sec currentCpuWaitTime;
     uint32_t currentFPS = 0;
     sec deltaTime = 0;
 
     bool monkeyMode = false;
-    bool exitAfterMainLoop = true;
+    EntityHandle mainMesh{}; // A MeshProxy until the first mesh is loaded
+    std::future<Components> mainMeshLoading{};
+    chrono_sec_point mainMeshLoadingStartTime{};
 };
 
 #endif //REALTIME_CELL_COLLAPSE_APPLICATION_H
@@ -0,0 +1,113 @@
+//
+// Created by Saman on 24.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_ARCHETYPE_H
+#define REALTIME_CELL_COLLAPSE_ARCHETYPE_H
+
+#include "preprocessor.h"
+#include "ecs/components.h"
+#include "ecs/entity_handle.h"
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+
+// Rows per chunk. Chunks are allocated once and never grow, so components keep their address while a column grows.
+const uint32_t ARCHETYPE_CHUNK_SIZE = 256;
+
+class ComponentColumn {
+public:
+    virtual ~ComponentColumn() = default;
+
+    // Moves the last component into the given row and shrinks the column by one
+    virtual void swapRemove(uint32_t row) = 0;
+
+    // Appends the component in the given row to the other column, which has to store the same type
+    virtual void moveTo(uint32_t row, ComponentColumn &target) = 0;
+};
+
+// Contiguous storage of one component type, for all entities of one archetype
+template<typename T>
+class Column : public ComponentColumn {
+public:
+    void push(T &&component) {
+        if (this->chunks.empty() || this->chunks.back().size() == ARCHETYPE_CHUNK_SIZE) {
+            this->chunks.emplace_back().reserve(ARCHETYPE_CHUNK_SIZE);
+        }
+        this->chunks.back().push_back(std::move(component));
+    }
+
+    void swapRemove(uint32_t row) override {
+        T &last = this->chunks.back().back();
+        T &removed = (*this)[row];
+        if (&removed != &last) {
+            removed = std::move(last);
+        }
+        this->chunks.back().pop_back();
+        if (this->chunks.back().empty()) {
+            this->chunks.pop_back();
+        }
+    }
+
+    void moveTo(uint32_t row, ComponentColumn &target) override {
+        static_cast<Column<T> &>(target).push(std::move((*this)[row]));
+    }
+
+    T &operator[](uint32_t row) {
+        return this->chunks[row / ARCHETYPE_CHUNK_SIZE][row % ARCHETYPE_CHUNK_SIZE];
+    }
+
+    [[nodiscard]] uint32_t getChunkCount() const {
+        return static_cast<uint32_t>(this->chunks.size());
+    }
+
+    [[nodiscard]] uint32_t getChunkSize(uint32_t chunk) const {
+        return static_cast<uint32_t>(this->chunks[chunk].size());
+    }
+
+    T *getChunk(uint32_t chunk) {
+        return this->chunks[chunk].data();
+    }
+
+private:
+    std::vector<std::vector<T>> chunks{};
+};
+
+// All entities with exactly the same set of components. Row i of every column belongs to the entity entities[i].
+struct Archetype {
+    explicit Archetype(const Signature &signature);
+
+    [[nodiscard]] uint32_t size() const {
+        return this->rowCount;
+    }
+
+    // Moves the components out of the bundle into a new row. Returns the row.
+    uint32_t insert(EntityHandle entity, Components &components);
+
+    // Appends the row to the other archetype, with the components both of them have. Returns the row in target.
+    // Components only target has have to be pushed by the caller, and the row here still has to be removed.
+    uint32_t moveRowTo(uint32_t row, Archetype &target);
+
+    // Fills the row with the last one. Returns the index of the entity that moved into the row, or UINT32_MAX.
+    uint32_t swapRemove(uint32_t row);
+
+    template<typename T>
+    Column<T> &getColumn() {
+        static_assert(!std::is_empty_v<T>, "Tag components have no column");
+        return *static_cast<Column<T> *>(this->columns[componentId<T>].get());
+    }
+
+    const Signature signature;
+    Column<EntityHandle> entities{};
+
+private:
+    // Empty for component types that are not part of the signature, and for tags
+    std::array<std::unique_ptr<ComponentColumn>, COMPONENT_TYPE_COUNT> columns{};
+    uint32_t rowCount = 0;
+};
+
+#endif //REALTIME_CELL_COLLAPSE_ARCHETYPE_H
@@ -0,0 +1,34 @@
+//
+// Created by Saman on 28.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_CHANGE_TRACKING_H
+#define REALTIME_CELL_COLLAPSE_CHANGE_TRACKING_H
+
+#include "preprocessor.h"
+
+#include <cstdint>
+
+/**
+ * Components that can change store the version of their last write. To find out what changed, remember current()
+ * and later compare component versions against it. Everything written after the call has a higher version.
+ */
+namespace ChangeTracking {
+    // A new version, higher than every one before. Thread safe.
+    uint64_t stamp();
+
+    // The latest version handed out
+    uint64_t current();
+
+    // True, if the component was written after the given version. Components without a version never are.
+    template<typename T>
+    bool isNewer(const T &component, uint64_t version) {
+        if constexpr (requires { component.version; }) {
+            return component.version > version;
+        } else {
+            return false;
+        }
+    }
+}
+
+#endif //REALTIME_CELL_COLLAPSE_CHANGE_TRACKING_H
@@ -8,21 +8,64 @@
 #include "preprocessor.h"
 #include "graphics/render_mesh.h"
 #include "graphics/render_mesh_simplifiable.h"
+#include "graphics/mesh_instance.h"
 #include "graphics/projector.h"
 #include "io/input_state.h"
 
-#include <mutex>
 #include <memory>
+#include <tuple>
+#include <bitset>
+#include <cstdint>
 
-struct Components {
-    bool isDestroyed = false;
-    bool willDestroy = false;
-    uint32_t index = 0;
+// Tag components carry no data, they only take part in the signature
+struct MainCamera {
+};
+
+struct RotatingSphere {
+};
+
+// Every component type the ECS can store. The position in this list is the component's bit in a Signature.
+using ComponentTypes = std::tuple<InputState, RenderMesh, RenderMeshSimplifiable, MeshInstance, Transformer4, Projector,
+        MainCamera, RotatingSphere>;
 
+constexpr uint32_t COMPONENT_TYPE_COUNT = std::tuple_size_v<ComponentTypes>;
+
+using Signature = std::bitset<COMPONENT_TYPE_COUNT>;
+
+template<typename T, typename Tuple>
+struct ComponentIndex;
+
+template<typename T, typename... Types>
+struct ComponentIndex<T, std::tuple<T, Types...>> {
+    static constexpr uint32_t value = 0;
+};
+
+template<typename T, typename First, typename... Types>
+struct ComponentIndex<T, std::tuple<First, Types...>> {
+    static constexpr uint32_t value = 1 + ComponentIndex<T, std::tuple<Types...>>::value;
+};
+
+template<typename T>
+constexpr uint32_t componentId = ComponentIndex<T, ComponentTypes>::value;
+
+template<typename... T>
+Signature signatureOf() {
+    Signature signature{};
+    (signature.set(componentId<T>), ...);
+    return signature;
+}
+
+/**
+ * The components of one entity before it is inserted.
+ * ECS::insert moves them into the columns of the archetype that matches their signature, so these pointers are empty
+ * afterwards. Once inserted, components are accessed through the ECS.
+ */
+struct Components {
     std::unique_ptr<InputState> inputState{nullptr};
 
     std::unique_ptr<RenderMesh> renderMesh{nullptr};
     std::unique_ptr<RenderMeshSimplifiable> renderMeshSimplifiable{nullptr};
+    std::unique_ptr<MeshInstance> instance{nullptr};
 
     std::unique_ptr<Transformer4> transform{nullptr};
 
@@ -31,28 +74,17 @@ struct Components {
 
     bool isRotatingSphere = false;
 
-    /**
-     * Destroys all contained entities.
-     *
-     * Warning: Do not call this manually. ECS calls this automatically when required.
-     */
-    void destroy() {
-        this->inputState.reset(nullptr);
-        this->renderMesh.reset(nullptr);
-        this->renderMeshSimplifiable.reset(nullptr);
-        this->transform.reset(nullptr);
-        this->camera.reset(nullptr);
-
-        this->isDestroyed = true;
-        this->willDestroy = false;
-    }
-
-    /**
-     * Convenience function
-     * @return True, if these entities are not and will not be destroyed this frame.
-     */
-    [[nodiscard]] bool isAlive() const {
-        return !isDestroyed && !willDestroy;
+    [[nodiscard]] Signature getSignature() const {
+        Signature signature{};
+        signature.set(componentId<InputState>, this->inputState != nullptr);
+        signature.set(componentId<RenderMesh>, this->renderMesh != nullptr);
+        signature.set(componentId<RenderMeshSimplifiable>, this->renderMeshSimplifiable != nullptr);
+        signature.set(componentId<MeshInstance>, this->instance != nullptr);
+        signature.set(componentId<Transformer4>, this->transform != nullptr);
+        signature.set(componentId<Projector>, this->camera != nullptr);
+        signature.set(componentId<MainCamera>, this->isMainCamera);
+        signature.set(componentId<RotatingSphere>, this->isRotatingSphere);
+        return signature;
     }
 };
 
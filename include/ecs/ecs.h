@@ -7,32 +7,212 @@
 
 #include "preprocessor.h"
 #include "ecs/components.h"
+#include "ecs/archetype.h"
+#include "ecs/query.h"
+#include "ecs/entity_handle.h"
+#include "ecs/change_tracking.h"
+#include "io/printer.h"
 
-#include <mutex>
 #include <vector>
-#include <optional>
 #include <tuple>
 #include <memory>
-#include <functional>
+#include <unordered_map>
+#include <string>
+#include <type_traits>
+#include <atomic>
 
+/**
+ * Archetype based storage: entities with the same set of components share one table, with one contiguous column
+ * per component type. Systems iterate over these columns instead of chasing a pointer per component.
+ */
 class ECS {
 public:
     void create();
 
     void destroy();
 
-    uint32_t insert(Components &entityComponents);
+    // Moves the components out of the bundle
+    EntityHandle insert(Components &entityComponents);
 
     // In every frame, always do inserts first, and deletions after. So that the renderer has time to handle allocation
-    void remove(const uint32_t &index);
+    void remove(const EntityHandle &entity);
 
-    std::vector<Components *>
-    requestEntities(const std::function<bool(const Components &)> &evaluator);
+    /**
+     * Destroys all removed entities. Call once per frame, after every system had the chance to react to removals.
+     * This moves components of other entities. While any entity is pinned, the removals stay pending instead.
+     */
+    void flushRemovals();
+
+    [[nodiscard]] bool hasPendingRemovals() const;
+
+    // True, if the entity exists and will not be destroyed this frame
+    [[nodiscard]] bool isAlive(const EntityHandle &entity) const;
+
+    [[nodiscard]] bool hasComponents(const EntityHandle &entity, const Signature &required) const;
+
+    /**
+     * Pinned entities keep their components where they are, so other threads can work on them without the ECS.
+     * Removals are not flushed and components can not be added or removed while any entity is pinned.
+     * Inserting is fine, as it never moves existing components. Unpinning may happen on any thread.
+     */
+    void pin(const EntityHandle &entity);
+
+    void unpin(const EntityHandle &entity);
+
+    // Throws if the entity does not exist or does not have a T
+    template<typename T>
+    T &get(const EntityHandle &entity);
+
+    // nullptr if the entity does not exist or does not have a T
+    template<typename T>
+    T *tryGet(const EntityHandle &entity);
+
+    // Moves the entity to the archetype with T. Replaces the component if it already has one.
+    template<typename T>
+    void addComponent(const EntityHandle &entity, T component = {});
+
+    // Moves the entity to the archetype without T
+    template<typename T>
+    void removeComponent(const EntityHandle &entity);
+
+    // True, if an archetype exists that both queries match
+    bool canOverlap(Query &a, Query &b);
+
+    // The first alive entity the query matches. Throws if there is none.
+    EntityHandle getFirst(Query &query);
+
+    /**
+     * Calls function(entity, T &...) for every alive entity the query matches. The query has to require all T.
+     * Tags only go into the query, since they have no data to pass.
+     * Entities must not be inserted and components must not be added or removed meanwhile.
+     */
+    template<typename... T, typename Function>
+    void forEach(Query &query, Function &&function);
+
+    // Like forEach, but only for entities where any of the T was written after the given version
+    template<typename... T, typename Function>
+    void forEachChanged(Query &query, uint64_t sinceVersion, Function &&function);
+
+    // Like forEach, but for the entities removed this frame, so systems can release what they hold for them
+    template<typename... T, typename Function>
+    void forEachRemoved(Function &&function);
 
 private:
-    void destroyReferences(const uint32_t &index);
+    struct EntityRecord {
+        Archetype *archetype = nullptr;
+        uint32_t row = 0;
+        uint32_t generation = 0;
+        bool isDestroyed = false;
+        bool willDestroy = false;
+    };
+
+    // nullptr for stale handles
+    [[nodiscard]] const EntityRecord *resolve(const EntityHandle &entity) const;
 
-    std::vector<Components> entities{};
+    Archetype &getArchetype(const Signature &signature);
+
+    // Brings the query's archetypes up to date with the ones created since it was last used
+    const std::vector<Archetype *> &getArchetypes(Query &query);
+
+    // Moves the entity to a row that was just appended to target
+    void relocate(const EntityHandle &entity, Archetype &target, uint32_t row);
+
+    std::vector<std::unique_ptr<Archetype>> archetypes{};
+    std::unordered_map<Signature, Archetype *> archetypesBySignature{};
+    std::vector<EntityRecord> records{};
+    std::vector<uint32_t> freeIndices{};
+    std::vector<EntityHandle> pendingRemovals{};
+    std::atomic<uint32_t> pinCount = 0;
 };
 
+template<typename T>
+T &ECS::get(const EntityHandle &entity) {
+    T *component = tryGet<T>(entity);
+    if (component == nullptr) {
+        THROW("Entity " + std::to_string(entity.index) + " does not have the requested component");
+    }
+    return *component;
+}
+
+template<typename T>
+T *ECS::tryGet(const EntityHandle &entity) {
+    const EntityRecord *record = resolve(entity);
+    if (record == nullptr || !record->archetype->signature[componentId<T>]) return nullptr;
+    return &record->archetype->template getColumn<T>()[record->row];
+}
+
+template<typename T>
+void ECS::addComponent(const EntityHandle &entity, T component) {
+    if (!isAlive(entity) || this->pinCount > 0) {
+        THROW("Can not add a component to entity " + std::to_string(entity.index));
+    }
+    EntityRecord &record = this->records[entity.index];
+    if (record.archetype->signature[componentId<T>]) {
+        if constexpr (!std::is_empty_v<T>) get<T>(entity) = std::move(component);
+        return;
+    }
+
+    Archetype &target = getArchetype(record.archetype->signature | signatureOf<T>());
+    const uint32_t row = record.archetype->moveRowTo(record.row, target);
+    if constexpr (!std::is_empty_v<T>) {
+        target.getColumn<T>().push(std::move(component));
+    }
+    relocate(entity, target, row);
+}
+
+template<typename T>
+void ECS::removeComponent(const EntityHandle &entity) {
+    if (!isAlive(entity) || this->pinCount > 0) {
+        THROW("Can not remove a component from entity " + std::to_string(entity.index));
+    }
+    EntityRecord &record = this->records[entity.index];
+    if (!record.archetype->signature[componentId<T>]) return;
+
+    Archetype &target = getArchetype(record.archetype->signature & ~signatureOf<T>());
+    relocate(entity, target, record.archetype->moveRowTo(record.row, target));
+}
+
+template<typename... T, typename Function>
+void ECS::forEach(Query &query, Function &&function) {
+    const Signature iterated = signatureOf<T...>();
+    if ((query.required & iterated) != iterated) {
+        THROW("Query does not require all iterated components");
+    }
+    const bool skipRemoved = !this->pendingRemovals.empty();
+
+    for (Archetype *archetype: getArchetypes(query)) {
+        for (uint32_t chunk = 0; chunk < archetype->entities.getChunkCount(); ++chunk) {
+            const EntityHandle *entities = archetype->entities.getChunk(chunk);
+            const uint32_t count = archetype->entities.getChunkSize(chunk);
+            std::tuple<T *...> columns{archetype->template getColumn<T>().getChunk(chunk)...};
+
+            std::apply([&](T *... column) {
+                for (uint32_t i = 0; i < count; ++i) {
+                    if (skipRemoved && this->records[entities[i].index].willDestroy) continue;
+                    function(entities[i], column[i]...);
+                }
+            }, columns);
+        }
+    }
+}
+
+template<typename... T, typename Function>
+void ECS::forEachChanged(Query &query, uint64_t sinceVersion, Function &&function) {
+    forEach<T...>(query, [&](const EntityHandle &entity, T &... components) {
+        if ((ChangeTracking::isNewer(components, sinceVersion) || ...)) {
+            function(entity, components...);
+        }
+    });
+}
+
+template<typename... T, typename Function>
+void ECS::forEachRemoved(Function &&function) {
+    const Signature required = signatureOf<T...>();
+    for (const EntityHandle &entity: this->pendingRemovals) {
+        const EntityRecord &record = this->records[entity.index];
+        if ((record.archetype->signature & required) != required) continue;
+        function(entity, record.archetype->template getColumn<T>()[record.row]...);
+    }
+}
+
 #endif //REALTIME_CELL_COLLAPSE_ECS_H
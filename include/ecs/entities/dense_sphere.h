@@ -10,6 +10,8 @@
 
 class DenseSphere: public Entity{
 public:
+    static constexpr const char *MODEL_PATH = "resources/models/dense_sphere.glb";
+
     DenseSphere();
 };
 
@@ -0,0 +1,18 @@
+//
+// Created by Saman on 22.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_GENERATED_MESH_H
+#define REALTIME_CELL_COLLAPSE_GENERATED_MESH_H
+
+#include "preprocessor.h"
+#include "ecs/entity.h"
+#include "util/importer.h"
+
+// Simplifiable entity around a mesh from MeshGenerators, set up like DenseSphere
+class GeneratedMesh : public Entity {
+public:
+    explicit GeneratedMesh(Importinator::Mesh mesh);
+};
+
+#endif //REALTIME_CELL_COLLAPSE_GENERATED_MESH_H
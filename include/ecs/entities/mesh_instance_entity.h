@@ -0,0 +1,23 @@
+//
+// Created by Saman on 16.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_INSTANCE_ENTITY_H
+#define REALTIME_CELL_COLLAPSE_MESH_INSTANCE_ENTITY_H
+
+#include "preprocessor.h"
+#include "ecs/entity.h"
+
+#include <glm/glm.hpp>
+
+// Side length of the instance grid that is spawned with INSTANCED_RENDERING
+#ifndef INSTANCE_GRID_SIZE
+#define INSTANCE_GRID_SIZE 5
+#endif
+
+class MeshInstanceEntity : public Entity {
+public:
+    MeshInstanceEntity(EntityHandle parent, glm::vec3 position);
+};
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_INSTANCE_ENTITY_H
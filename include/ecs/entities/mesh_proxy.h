@@ -0,0 +1,27 @@
+//
+// Created by Saman on 21.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_PROXY_H
+#define REALTIME_CELL_COLLAPSE_MESH_PROXY_H
+
+#include "preprocessor.h"
+#include "ecs/entity.h"
+
+#include <glm/glm.hpp>
+#include <string>
+
+// Bounding box shown in place of a mesh that is still loading
+class MeshProxy : public Entity {
+public:
+    // Unit sized box, for meshes without a model file
+    MeshProxy();
+
+    // Takes the bounds from the model's mesh cache, or a unit sized box if there is none yet
+    explicit MeshProxy(const std::string &modelPath);
+
+private:
+    void createBox(const glm::vec3 &min, const glm::vec3 &max);
+};
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_PROXY_H
@@ -10,6 +10,8 @@
 
 class Monkey: public Entity{
 public:
+    static constexpr const char *MODEL_PATH = "resources/models/monkey.glb";
+
     Monkey();
 };
 
@@ -10,7 +10,7 @@
 
 class Entity{
 public:
-    void upload(ECS &ecs);
+    EntityHandle upload(ECS &ecs);
 
     Components components{};
 };
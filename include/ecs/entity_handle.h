@@ -0,0 +1,19 @@
+//
+// Created by Saman on 26.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_ENTITY_HANDLE_H
+#define REALTIME_CELL_COLLAPSE_ENTITY_HANDLE_H
+
+#include <cstdint>
+
+// Identifies an entity in the ECS. Stays valid across frames, and can be checked for whether the entity still exists.
+struct EntityHandle {
+    uint32_t index = UINT32_MAX;
+    // Incremented whenever the index is reused, so handles to destroyed entities do not resolve to new ones
+    uint32_t generation = 0;
+
+    bool operator==(const EntityHandle &other) const = default;
+};
+
+#endif //REALTIME_CELL_COLLAPSE_ENTITY_HANDLE_H
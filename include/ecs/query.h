@@ -0,0 +1,47 @@
+//
+// Created by Saman on 25.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_QUERY_H
+#define REALTIME_CELL_COLLAPSE_QUERY_H
+
+#include "preprocessor.h"
+#include "ecs/components.h"
+#include "ecs/archetype.h"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+/**
+ * Entities with all required and none of the excluded components. Declare a query once and keep it, e.g. next to the
+ * system that uses it. It caches the matching archetypes. Archetypes are never removed, so the ECS only has to check
+ * the ones created since the query was last used, which usually means none.
+ *
+ * Safe to use from several threads at once, as long as no entities are inserted meanwhile.
+ */
+class Query {
+public:
+    explicit Query(const Signature &required, const Signature &excluded = {})
+            : required(required), excluded(excluded) {}
+
+    Query(const Query &) = delete;
+
+    Query &operator=(const Query &) = delete;
+
+    [[nodiscard]] bool matches(const Signature &signature) const {
+        return (signature & this->required) == this->required && (signature & this->excluded).none();
+    }
+
+    const Signature required;
+    const Signature excluded;
+
+private:
+    friend class ECS;
+
+    std::vector<Archetype *> archetypes{};
+    std::atomic<size_t> checkedArchetypeCount = 0;
+    std::mutex updateMutex{};
+};
+
+#endif //REALTIME_CELL_COLLAPSE_QUERY_H
@@ -0,0 +1,50 @@
+//
+// Created by Saman on 27.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_SCHEDULER_H
+#define REALTIME_CELL_COLLAPSE_SCHEDULER_H
+
+#include "preprocessor.h"
+#include "util/timer.h"
+#include "ecs/ecs.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Runs the systems of a frame on the ThreadPool. Every system declares which components it reads and writes, and of
+ * which entities. Two systems conflict if one writes a component the other reads or writes, on entities both of them
+ * can reach. Conflicting systems run in the order they were added, all others run in parallel.
+ */
+class Scheduler {
+public:
+    // Components of the entities a query matches that a system reads or writes
+    struct Access {
+        Query *query = nullptr;
+        Signature reads{};
+        Signature writes{};
+    };
+
+    struct SystemEntry {
+        std::string name;
+        std::vector<Access> access;
+        std::function<void(sec delta, ECS &ecs)> update;
+    };
+
+    void add(SystemEntry system);
+
+    // Runs every system once and blocks until all are done. Nothing else may access the ECS meanwhile.
+    void run(sec delta, ECS &ecs);
+
+private:
+    static bool conflicts(const SystemEntry &a, const SystemEntry &b, ECS &ecs);
+
+    std::vector<SystemEntry> systems{};
+    // Per frame, reused to avoid allocations
+    std::vector<uint32_t> stages{};
+    std::vector<uint32_t> stageSystems{};
+};
+
+#endif //REALTIME_CELL_COLLAPSE_SCHEDULER_H
@@ -15,9 +15,7 @@ namespace CameraController{
 
     void destroy();
 
-    static inline bool EvaluatorActiveCamera(const Components &components) {
-        return components.camera != nullptr && components.transform != nullptr && components.isAlive() && components.isMainCamera;
-    };
+    inline Query QueryActiveCamera{signatureOf<Projector, Transformer4, MainCamera>()};
 };
 
 #endif //REALTIME_CELL_COLLAPSE_CAMERA_CONTROLLER_H
@@ -14,9 +14,7 @@ namespace MeshSimplifierController {
 
     void destroy();
 
-    static inline bool EvaluatorToSimplify(const Components &components) {
-        return components.renderMesh != nullptr && components.transform != nullptr && components.isAlive() &&
-               components.renderMeshSimplifiable != nullptr && !components.renderMeshSimplifiable->updateSimplifiedMesh;
-    };
+    // Only those that do not wait for their last result to be uploaded
+    inline Query QueryToSimplify{signatureOf<RenderMesh, RenderMeshSimplifiable, Transformer4>()};
 };
 #endif //REALTIME_CELL_COLLAPSE_MESH_SIMPLIFIER_CONTROLLER_H
@@ -15,8 +15,6 @@ namespace SphereController {
 
     void destroy();
 
-    static inline bool EvaluatorRotatingSphere(const Components &components) {
-        return components.transform != nullptr && components.isAlive() && components.isRotatingSphere;
-    };
+    inline Query QueryRotatingSphere{signatureOf<Transformer4, RotatingSphere>()};
 };
 #endif //REALTIME_CELL_COLLAPSE_SPHERE_CONTROLLER_H
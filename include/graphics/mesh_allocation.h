@@ -0,0 +1,27 @@
+//
+// Created by Saman on 30.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_ALLOCATION_H
+#define REALTIME_CELL_COLLAPSE_MESH_ALLOCATION_H
+
+#include "preprocessor.h"
+
+#include <cstdint>
+
+// Where a mesh lives in the shared vertex, index and cluster buffers. Counted in elements, not bytes.
+struct MeshAllocation {
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    uint32_t firstCluster = 0; // The whole mesh, followed by its parts. See MeshProcessing::buildClusters.
+    uint32_t clusterCount = 0;
+    uint64_t uploadValue = 0; // Upload timeline value after which the buffers hold the mesh
+
+    [[nodiscard]] bool isValid() const {
+        return this->vertexCount > 0;
+    }
+};
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_ALLOCATION_H
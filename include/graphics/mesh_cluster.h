@@ -0,0 +1,26 @@
+//
+// Created by Saman on 30.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_CLUSTER_H
+#define REALTIME_CELL_COLLAPSE_MESH_CLUSTER_H
+
+#include "preprocessor.h"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// A run of consecutive triangles that the culling compute shader accepts or rejects as a whole.
+// Same layout as the Cluster struct in cull.comp.
+struct MeshCluster {
+    alignas(16) glm::vec4 bounds; // xyz center, w radius. In model space.
+    // xyz average facing direction, w cutoff. A camera inside the cone sees only back faces. > 1 never culls.
+    alignas(16) glm::vec4 cone;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t padding[2];
+};
+
+static_assert(sizeof(MeshCluster) == 48, "MeshCluster has to match the std430 layout in cull.comp");
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_CLUSTER_H
@@ -0,0 +1,20 @@
+//
+// Created by Saman on 16.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_INSTANCE_H
+#define REALTIME_CELL_COLLAPSE_MESH_INSTANCE_H
+
+#include "preprocessor.h"
+
+#include "ecs/entity_handle.h"
+
+#include <cstdint>
+
+// Places another copy of the mesh owned by the parent entity.
+// The entity's own transform is applied on top of the parent's.
+struct MeshInstance {
+    EntityHandle parent{};
+};
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_INSTANCE_H
@@ -9,6 +9,7 @@
 #include "physics/transformer.h"
 
 #include <glm/glm.hpp>
+#include <array>
 
 struct Projector {
     float fovYRadians = glm::radians(45.0f);
@@ -20,6 +21,11 @@ struct Projector {
     [[nodiscard]] glm::mat4 getProjection(float aspectRatio) const;
 
     [[nodiscard]] glm::mat4 getView(const Transformer4 &eye) const;
+
+    // Normalized planes (xyz = inward normal, w = distance) in the space that viewProjection transforms from
+    static std::array<glm::vec4, 6> getFrustumPlanes(const glm::mat4 &viewProjection);
+
+    static bool isSphereInFrustum(const std::array<glm::vec4, 6> &planes, glm::vec3 center, float radius);
 };
 
 #endif //REALTIME_CELL_COLLAPSE_PROJECTOR_H
@@ -7,14 +7,39 @@
 
 #include "preprocessor.h"
 #include "graphics/vertex.h"
+#include "util/importer.h"
+#include "ecs/change_tracking.h"
+#include "graphics/mesh_allocation.h"
+
+#include <glm/glm.hpp>
 
 #include <vector>
 
 struct RenderMesh {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
-    bool isAllocated = false;
-    int bufferIndex = 0;
+    std::vector<Importinator::Submesh> submeshes; // Can be handled independently, e.g. by the simplifier
+    std::vector<Importinator::Lod> lods; // Precomputed at import, finest first
+    MeshAllocation allocation{}; // Owned by this mesh. Released through VulkanBuffers::releaseMesh.
+    bool isTooLarge = false; // For the shared mesh buffers, so the upload is not retried
+
+    // Bounding sphere in model space, used for culling and by the simplifier thread.
+    // Set with setBounds before the entity is inserted, and constant after.
+    glm::vec3 boundsCenter{0.0f};
+    float boundsRadius = 0.0f;
+
+    // Encloses the axis aligned bounding box
+    void setBounds(const glm::vec3 &min, const glm::vec3 &max) {
+        this->boundsCenter = (min + max) * 0.5f;
+        this->boundsRadius = glm::length(max - min) * 0.5f;
+    }
+
+    // Call after editing the mesh, so systems that depend on it notice
+    void markChanged() {
+        this->version = ChangeTracking::stamp();
+    }
+
+    uint64_t version = ChangeTracking::stamp();
 };
 
 #endif //REALTIME_CELL_COLLAPSE_RENDER_MESH_H
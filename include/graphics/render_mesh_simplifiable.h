@@ -7,17 +7,47 @@
 
 #include "preprocessor.h"
 #include "graphics/vertex.h"
+#include "ecs/change_tracking.h"
+#include "graphics/mesh_allocation.h"
 
 #include <vector>
 #include <mutex>
+#include <utility>
 
 struct RenderMeshSimplifiable {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
-    bool isAllocated = false;
-    uint32_t bufferIndex = 0;
+    // Double buffered: Drawn while the next simplified mesh is uploading, which replaces it once it arrived.
+    // Invalid to draw the RenderMesh instead.
+    MeshAllocation allocation{};
+    MeshAllocation pendingAllocation{};
+    bool isEmpty = false; // The latest simplification left nothing to draw, so neither it nor the RenderMesh is drawn
     bool updateSimplifiedMesh = false;
     std::mutex simplifiedMeshMutex = std::mutex{};
+    uint64_t version = ChangeTracking::stamp();
+
+    RenderMeshSimplifiable() = default;
+
+    // Call after replacing the simplified mesh
+    void markChanged() {
+        this->version = ChangeTracking::stamp();
+    }
+
+    // The ECS moves components around within their column. The mutex stays where it is, and must not be held then.
+    RenderMeshSimplifiable(RenderMeshSimplifiable &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    RenderMeshSimplifiable &operator=(RenderMeshSimplifiable &&other) noexcept {
+        this->vertices = std::move(other.vertices);
+        this->indices = std::move(other.indices);
+        this->allocation = other.allocation;
+        this->pendingAllocation = other.pendingAllocation;
+        this->isEmpty = other.isEmpty;
+        this->updateSimplifiedMesh = other.updateSimplifiedMesh;
+        this->version = other.version;
+        return *this;
+    }
 };
 
 #endif //REALTIME_CELL_COLLAPSE_RENDER_MESH_SIMPLIFIABLE_H
@@ -18,6 +18,7 @@
 #include "graphics/vulkan/vulkan_devices.h"
 #include "graphics/vulkan/vulkan_instance.h"
 #include "graphics/render_state.h"
+#include "graphics/vulkan/vulkan_swapchain.h"
 
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
@@ -32,11 +33,11 @@
 #include <limits> // Necessary for std::numeric_limits
 #include <algorithm> // Necessary for std::clamp
 #include <thread>
+#include <unordered_map>
+#include <array>
 
 //#define WIREFRAME_MODE
-#define INSTANCED_RENDERING
-
-// TODO https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Frames_in_flight
+#define INSTANCED_RENDERING // Spawn a grid of instances of the main mesh
 
 class Renderer {
 public:
@@ -48,17 +49,38 @@ public:
 
     UiState *getUiState();
 
-    void resetMesh();
+    // Draw the original meshes again, until the next simplified ones arrive
+    void resetMesh(ECS &ecs);
 
 private:
 
     void createGraphicsPipeline();
 
+    // Rebuilds the graphics and UI pipelines against a new render pass
+    void recreatePipelines();
+
     void createDescriptorSetLayout();
 
     // TODO Take out delta time
     void updateUniformBuffer(const sec &delta, ECS &ecs);
 
+    // Culls all instances against the camera frustum and writes the visible ones to this frame's instance buffer.
+    // Writes one indirect draw per mesh with visible instances.
+    void updateDrawBuffers(ECS &ecs);
+
+    // Writes every instance and one cull job per instance, for cull.comp to write the draws
+    void updateCullJobs(ECS &ecs);
+
+    // Decides between GPU and CPU culling, and creates the compute pipeline for the former
+    void createCullingPipeline();
+
+    void createCullingDescriptorSet();
+
+    void destroyCulling();
+
+    // Before the render pass, which draws what this leaves
+    void recordCulling(VkCommandBuffer buffer);
+
     void createDescriptorPool();
 
     void createDescriptorSets();
@@ -69,45 +91,37 @@ private:
 
     VkShaderModule createShaderModule(const std::vector<char> &code);
 
+    VkShaderModule createShaderModule(const uint32_t *code, size_t byteSize);
+
     void createCommandPool();
 
     // TODO void createTextureImage();
 
     void createSyncObjects();
 
-    void recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex);
+    void recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex, ECS &ecs);
 
-    static inline bool EvaluatorActiveCamera(const Components &components) {
-        return components.camera != nullptr && components.transform != nullptr && components.isAlive() &&
-               components.isMainCamera;
-    };
+    static inline Query QueryActiveCamera{signatureOf<Projector, Transformer4, MainCamera>()};
 
-    static inline bool EvaluatorToAllocate(const Components &components) {
-        return components.renderMesh != nullptr && components.isAlive() && !components.renderMesh->isAllocated;
-    };
+    static inline Query QueryMeshes{signatureOf<RenderMesh>()};
 
-    static inline bool EvaluatorToAllocateSimplifiedMesh(const Components &components) {
-        return components.renderMesh != nullptr && components.isAlive() &&
-               components.renderMeshSimplifiable != nullptr && components.renderMeshSimplifiable->updateSimplifiedMesh;
-    };
+    static inline Query QuerySimplifiedMeshes{signatureOf<RenderMesh, RenderMeshSimplifiable>()};
 
-    static inline bool EvaluatorToDeallocate(const Components &components) {
-        return components.renderMesh != nullptr && components.willDestroy && components.renderMesh->isAllocated;
-    };
+    static inline Query QueryToDraw{signatureOf<RenderMesh, Transformer4>()};
 
-    static inline bool EvaluatorToDraw(const Components &components) {
-        return components.renderMesh != nullptr && components.transform != nullptr && components.isAlive() &&
-               components.renderMesh->isAllocated;
-    };
+    static inline Query QueryInstances{signatureOf<MeshInstance, Transformer4>()};
 
     void uploadRenderables(ECS &ecs);
 
-    // return buffer to use
     void uploadSimplifiedMeshes(ECS &ecs);
 
     void destroyRenderables(ECS &ecs);
 
-    void drawUi();
+    // nullptr if the mesh can not be drawn yet, because nothing of it has been uploaded
+    static const MeshAllocation *getDrawnAllocation(ECS &ecs, const EntityHandle &entity, const RenderMesh &mesh,
+                                                    uint64_t uploadedValue);
+
+    void drawUi(VkCommandBuffer buffer);
 
     RenderState state{};
 
@@ -116,14 +130,45 @@ private:
 
     VkDescriptorSetLayout descriptorSetLayout = nullptr;
     VkDescriptorPool descriptorPool = nullptr;
-    std::vector<VkDescriptorSet> descriptorSets{}; // Will be cleaned up with pool
+    VkDescriptorSet descriptorSet = nullptr; // Will be cleaned up with pool. Per-frame data via dynamic offset
     VkPipelineLayout pipelineLayout = nullptr;
     VkPipeline graphicsPipeline = nullptr;
     VkCommandPool commandPool = nullptr;
 
-    VkSemaphore imageAvailableSemaphore = nullptr;
-    VkSemaphore renderFinishedSemaphore = nullptr;
-    VkFence inFlightFence = nullptr;
+    // https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/Frames_in_flight
+    // Index into all per-frame resources: command buffers, sync objects, uniform buffers and descriptor sets
+    uint32_t currentFrame = 0;
+    std::vector<VkSemaphore> imageAvailableSemaphores{};
+    std::vector<VkSemaphore> renderFinishedSemaphores{};
+    std::vector<VkFence> inFlightFences{};
+
+    // Culls in cull.comp instead of on the CPU, if the device can draw with a draw count written by the GPU
+    bool isGpuCulling = false;
+    uint32_t maxIndirectDraws = 0; // MAX_DRAWS, or less if the device can not draw that many per call
+    bool isCullingWholeMeshes = false; // Set once cull.comp had more surviving clusters than draws
+    VkDescriptorSetLayout cullDescriptorSetLayout = nullptr;
+    VkDescriptorPool cullDescriptorPool = nullptr;
+    VkDescriptorSet cullDescriptorSet = nullptr; // Per-frame data via dynamic offsets
+    VkPipelineLayout cullPipelineLayout = nullptr;
+    VkPipeline cullPipeline = nullptr;
+
+    // Written for the current frame
+    uint32_t cullJobCount = 0;
+    uint32_t maxClustersPerJob = 0;
+    CullPushConstants cullPushConstants{};
+
+    // Indirect draws written by the CPU for the current frame
+    uint32_t drawCount = 0;
+
+    // Upload timeline value that all meshes drawn in the current frame have reached
+    uint64_t drawnUploadValue = 0;
+
+    // What each frame's uniform buffer slot was last written for
+    struct UniformBufferState {
+        uint64_t cameraVersion = 0;
+        float aspectRatio = 0.0f;
+    };
+    std::array<UniformBufferState, MAX_FRAMES_IN_FLIGHT> uniformBufferStates{};
 };
 
 #endif //REALTIME_CELL_COLLAPSE_RENDERER_H
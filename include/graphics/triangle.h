@@ -14,15 +14,15 @@ public:
     RenderMesh mesh{
             .vertices{
                     {{0.0f,  0.0f,  0.0f},
-                            Color::fromRGB({1.0f, 1.0f, 1.0f}).setLumaLab(90).getLAB()},
+                            Color::fromRGB({1.0f, 1.0f, 1.0f}).setLumaLab(90).getRGB()},
                     {{0.5f,  -0.5f, 0.0f},
-                            Color::fromRGB({0.0f, 0.0f, 1.0f}).setLumaLab(40).getLAB()},
+                            Color::fromRGB({0.0f, 0.0f, 1.0f}).setLumaLab(40).getRGB()},
                     {{0.5f,  0.5f,  0.0f},
-                            Color::fromRGB({1.0f, 0.0f, 0.0f}).setLumaLab(40).getLAB()},
+                            Color::fromRGB({1.0f, 0.0f, 0.0f}).setLumaLab(40).getRGB()},
                     {{-0.5f, -0.5f, 0.0f},
-                            Color::fromRGB({1.0f, 0.0f, 0.0f}).setLumaLab(40).getLAB()},
+                            Color::fromRGB({1.0f, 0.0f, 0.0f}).setLumaLab(40).getRGB()},
                     {{-0.5f, 0.5f,  0.0f},
-                            Color::fromRGB({0.0f, 0.0f, 1.0f}).setLumaLab(40).getLAB()}
+                            Color::fromRGB({0.0f, 0.0f, 1.0f}).setLumaLab(40).getRGB()}
             },
             .indices{
                     0, 3, 1,
@@ -19,13 +19,20 @@ struct UiState {
 
     FPSCounter fps{};
     sec cpuWaitTime = 0;
+    sec timeToFirstFrame = 0;
+    sec timeToInteractive = 0;
     bool loggingStarted = false;
     chrono_sec_point loggingStartTime{};
 
     uint32_t currentMeshVertices = 0;
     uint32_t currentMeshTriangles = 0;
+    uint32_t instancesDrawn = 0;
+    uint32_t instancesCulled = 0;
+    bool isGpuCulling = false;
+    uint32_t gpuDraws = 0; // Clusters and instances left by cull.comp, a few frames ago
     bool isMonkeyMesh = false;
     bool switchMesh = false;
+    sec meshSwitchTimeTaken = 0.0f;
 
     sec meshSimplifierTimeTaken = 0.0f;
     uint32_t meshSimplifierFramesTaken = 0;
@@ -8,11 +8,36 @@
 #include "preprocessor.h"
 
 #include <glm/glm.hpp>
+#include <cstdint>
 
+// Per frame. Lives in a ring buffer and is bound with a dynamic offset.
 struct UniformBufferObject {
-    alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
 };
 
+// Per drawn instance, including meshes that are drawn once. Lives in the instance storage buffer.
+struct InstanceData {
+    alignas(16) glm::mat4 model; // Model to world, including the instance placement
+    alignas(16) glm::mat4 normal; // transpose(inverse(model)), upper 3x3 only
+};
+
+// Per instance culled on the GPU. Lives in the cull job buffer, read by cull.comp.
+struct CullJob {
+    uint32_t instance; // Into this frame's instance buffer. Becomes the firstInstance of every draw.
+    uint32_t boundsCluster; // Tested first, to reject the whole instance
+    uint32_t firstCluster; // Every one of these that survives gets its own draw
+    uint32_t clusterCount;
+    int32_t vertexOffset;
+};
+
+// Per dispatch of cull.comp
+struct CullPushConstants {
+    alignas(16) glm::vec4 frustum[6]; // World space, see Projector::getFrustumPlanes
+    alignas(16) glm::vec4 cameraPosition; // World space, w unused
+    uint32_t firstJob;
+    uint32_t jobCount;
+    uint32_t maxDraws;
+};
+
 #endif //REALTIME_CELL_COLLAPSE_UNIFORM_BUFFER_OBJECT_H
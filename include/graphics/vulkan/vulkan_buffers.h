@@ -7,58 +7,96 @@
 
 #include "preprocessor.h"
 #include "graphics/triangle.h"
+#include "graphics/mesh_allocation.h"
+#include "graphics/uniform_buffer_object.h"
 #include "util/byte_size.h"
 #include "vulkan_devices.h"
 
 #include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
 
 namespace VulkanBuffers {
     extern const uint32_t UBO_BUFFER_COUNT;
+    extern const uint32_t UPLOAD_COMMAND_BUFFER_COUNT;
+    extern const uint32_t MAX_INSTANCES; // Per frame
+    extern const uint32_t MAX_DRAWS; // Indirect draws per frame. One per drawn mesh, or per cluster left by cull.comp
+    extern const uint32_t MAX_CLUSTERS; // In the shared cluster buffer
     extern const uint32_t DEFAULT_ALLOCATION_SIZE;
+    extern const VkDeviceSize MESH_BUFFER_SIZE; // Of the shared vertex and of the shared index buffer
     extern uint32_t maxAllocations, currentAllocations;
 
-    extern VkCommandBuffer commandBuffer; // Cleaned automatically by command pool clean.
-    extern VkBuffer vertexBuffer[];
-    extern uint32_t vertexCount[];
-    extern VkBuffer indexBuffer[];
-    extern uint32_t indexCount[];
-    extern uint32_t meshBufferToUse;
-    extern uint32_t uniformBufferIndex;
+    extern std::vector<VkCommandBuffer> commandBuffers; // One per frame in flight. Cleaned automatically by command pool clean.
+    // Shared by all meshes, which own sub-allocations of them. See MeshAllocation.
+    extern VkBuffer vertexBuffer;
+    extern VkBuffer indexBuffer;
 
     extern VkPhysicalDeviceMemoryProperties memProperties;
 
-    extern VkDeviceMemory vertexBufferMemory[];
-    extern VkDeviceMemory indexBufferMemory[];
-    extern std::vector<VkBuffer> uniformBuffers;
-    extern std::vector<VkDeviceMemory> uniformBuffersMemory;
-    extern std::vector<void *> uniformBuffersMapped;
+    extern VkDeviceMemory vertexBufferMemory;
+    extern VkDeviceMemory indexBufferMemory;
+    extern VkBuffer uniformBuffer; // One UBO_BUFFER_COUNT sized ring, indexed via dynamic offsets
+    extern VkDeviceMemory uniformBufferMemory;
+    extern void *uniformBufferMapped;
+    extern VkDeviceSize uniformBufferStride; // sizeof(UniformBufferObject) padded to the device alignment
+    extern VkBuffer instanceBuffer; // InstanceData, one MAX_INSTANCES sized region per frame in flight
+    extern VkDeviceMemory instanceBufferMemory;
+    extern void *instanceBufferMapped;
+    extern VkDeviceSize instanceBufferStride;
+    extern VkBuffer clusterBuffer; // MeshClusters of all meshes, allocated with them
+    extern VkDeviceMemory clusterBufferMemory;
+    extern VkBuffer cullJobBuffer; // CullJobs, one MAX_INSTANCES sized region per frame in flight
+    extern VkDeviceMemory cullJobBufferMemory;
+    extern void *cullJobBufferMapped;
+    extern VkDeviceSize cullJobBufferStride;
+    // Per frame in flight: The number of draws, padded to 16 bytes, followed by MAX_DRAWS
+    // VkDrawIndexedIndirectCommands. Written by the CPU, or by cull.comp.
+    extern VkBuffer indirectBuffer;
+    extern VkDeviceMemory indirectBufferMemory;
+    extern void *indirectBufferMapped;
+    extern VkDeviceSize indirectBufferStride;
 
     extern VkQueue transferQueue;
     extern VkCommandPool transferCommandPool;
     extern VkCommandBuffer transferCommandBuffer; // Cleaned automatically by command pool clean.
-    extern bool waitingForFence;
-    extern VkFence uploadFence;
 
     void create();
 
     void destroy();
 
-    void createCommandBuffer(VkCommandPool commandPool);
+    void createCommandBuffers(VkCommandPool commandPool);
 
-    void destroyCommandBuffer(VkCommandPool commandPool);
+    void destroyCommandBuffers(VkCommandPool commandPool);
 
-    void nextUniformBuffer();
+    void *getUniformBufferMapping(uint32_t frame);
 
-    void *getCurrentUniformBufferMapping();
+    uint32_t getUniformBufferOffset(uint32_t frame);
 
-    void uploadVertices(const std::vector<Vertex> &vertices, uint32_t bufferIndex = 0);
+    InstanceData *getInstanceBufferMapping(uint32_t frame);
 
-    void uploadIndices(const std::vector<uint32_t> &indices, uint32_t bufferIndex = 0);
+    uint32_t getInstanceBufferOffset(uint32_t frame);
 
-    void uploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
-                    bool parallel = false, uint32_t bufferIndex = 0);
+    VkDrawIndexedIndirectCommand *getDrawCommandMapping(uint32_t frame);
 
-    VkBuffer getCurrentUniformBuffer();
+    uint32_t *getDrawCountMapping(uint32_t frame);
+
+    VkDeviceSize getDrawCommandOffset(uint32_t frame);
+
+    VkDeviceSize getDrawCountOffset(uint32_t frame);
+
+    CullJob *getCullJobMapping(uint32_t frame);
+
+    uint32_t getCullJobOffset(uint32_t frame);
+
+    // Asynchronous. Draw the returned allocation once its uploadValue is reached on the upload timeline.
+    // Invalid if the shared buffers have no room for the mesh right now.
+    MeshAllocation uploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+    // Frees the allocation once the GPU is done with every frame and upload submitted so far, and invalidates it
+    void releaseMesh(MeshAllocation &allocation);
+
+    // False if a mesh of this size would not fit the shared buffers even if they were empty, so uploadMesh never can
+    bool canEverFitMesh(size_t vertexCount, size_t indexCount);
 
     void createVertexBuffer();
 
@@ -66,24 +104,30 @@ namespace VulkanBuffers {
 
     void createUniformBuffers();
 
+    void createInstanceBuffers();
+
+    void createIndirectBuffers();
+
+    void createClusterBuffer();
+
+    void createCullJobBuffers();
+
     void createCommandBuffer(VkCommandPool commandPool, VkCommandBuffer *pBuffer);
 
     void createTransferCommandPool();
 
-    void createUploadFence();
+    void createUploadCommandBuffers();
 
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer *pBuffer,
                       VkDeviceMemory *pBufferMemory);
 
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, bool parallel = false);
 
-    bool isTransferQueueReady();
-
-    void finishTransfer();
-
-    void waitForTransfer();
+    // True if another asynchronous upload can be submitted right now
+    bool canUpload();
 
-    void resetMeshBufferToUse();
+    // Recycles the command buffers of all uploads the GPU has finished. Never blocks.
+    void reclaimFinishedUploads();
 }
 
 #endif //REALTIME_CELL_COLLAPSE_VULKAN_BUFFERS_H
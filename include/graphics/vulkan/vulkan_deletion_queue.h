@@ -0,0 +1,28 @@
+//
+// Created by Saman on 29.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_VULKAN_DELETION_QUEUE_H
+#define REALTIME_CELL_COLLAPSE_VULKAN_DELETION_QUEUE_H
+
+#include "preprocessor.h"
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// GPU resources that must outlive every submission that may still read or write them
+namespace VulkanDeletionQueue {
+    // Runs the deleter once the GPU has finished every frame and every upload submitted so far
+    void enqueue(std::function<void()> &&deleter);
+
+    // Runs the deleters whose submissions have finished on the GPU. Never blocks.
+    void collect();
+
+    // Runs all remaining deleters. Only call once the device is idle.
+    void destroy();
+
+    size_t getPendingCount();
+}
+
+#endif //REALTIME_CELL_COLLAPSE_VULKAN_DELETION_QUEUE_H
@@ -15,6 +15,10 @@
 namespace VulkanDevices {
     struct OptionalFeatures {
         bool supportsWireframeMode = false;
+        bool supportsMultiDrawIndirect = false; // More than one draw per indirect call
+        bool supportsDrawIndirectCount = false; // Draw count read from a buffer
+        bool supportsDrawIndirectFirstInstance = false; // Indirect draws that start at another instance than 0
+        bool supportsGraphicsQueueCompute = false; // Compute dispatches in the same command buffers as draws
         bool physicalDeviceFeatures2 = false;
     };
 
@@ -51,6 +55,8 @@ namespace VulkanDevices {
 
     static bool checkExtensionSupport(VkPhysicalDevice device);
 
+    static bool checkFeatureSupport(VkPhysicalDevice device);
+
     static bool checkPortabilityMode(VkPhysicalDevice device);
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
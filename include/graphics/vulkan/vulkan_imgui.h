@@ -12,7 +12,10 @@
 namespace VulkanImgui {
     void create(RenderState &state);
 
-    void draw(RenderState &state);
+    // Rebuilds the Vulkan side of the UI against a new render pass. Waits for the frames in flight.
+    void recreateRenderer();
+
+    void draw(RenderState &state, VkCommandBuffer commandBuffer);
 
     void recalculateScale(RenderState &state);
 
@@ -0,0 +1,27 @@
+//
+// Created by Saman on 17.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_VULKAN_PIPELINE_CACHE_H
+#define REALTIME_CELL_COLLAPSE_VULKAN_PIPELINE_CACHE_H
+
+#include "preprocessor.h"
+
+#include <vulkan/vulkan.h>
+#include <string>
+
+// Keeps compiled pipelines across launches.
+// https://zeux.io/2019/07/17/serializing-pipeline-cache/
+namespace VulkanPipelineCache {
+    extern const std::string CACHE_FILE;
+
+    extern VkPipelineCache cache;
+
+    // Loads the cache from disk, if it was written by the same device and driver
+    void create();
+
+    // Writes the cache back to disk
+    void destroy();
+}
+
+#endif //REALTIME_CELL_COLLAPSE_VULKAN_PIPELINE_CACHE_H
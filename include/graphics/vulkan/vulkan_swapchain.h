@@ -12,7 +12,11 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
-//const int MAX_FRAMES_IN_FLIGHT = 2;
+// How many frames the CPU may record ahead of the GPU. Configured through CMake.
+#ifndef FRAMES_IN_FLIGHT
+#define FRAMES_IN_FLIGHT 2
+#endif
+const uint32_t MAX_FRAMES_IN_FLIGHT = FRAMES_IN_FLIGHT;
 
 namespace VulkanSwapchain {
     struct SwapchainSupportDetails {
@@ -34,6 +38,9 @@ namespace VulkanSwapchain {
     extern std::vector<VkImageView> imageViews;
     extern std::vector<VkFramebuffer> framebuffers;
     extern bool needsNewSwapchain;
+    // Set when the render pass was replaced, e.g. for a new surface format. Pipelines built against the old one
+    // have to be rebuilt. Cleared by whoever rebuilds them.
+    extern bool hasNewRenderPass;
 
     extern VkImage depthImage;
     extern VkDeviceMemory depthImageMemory;
@@ -51,10 +58,22 @@ namespace VulkanSwapchain {
 
     bool shouldRecreateSwapchain();
 
-    bool createSwapchain();
+    // Pass the current swapchain as oldSwapchain when recreating, so the driver can hand over its resources
+    bool createSwapchain(VkSwapchainKHR oldSwapchain = nullptr);
 
+    // Does not wait for the device. Replaced resources are retired until the frames using them have finished and
+    // their images have been presented.
     bool recreateSwapchain(RenderState &state);
 
+    // Destroys retired resources whose last frame has finished on the GPU, and whose swapchain images are no longer
+    // being presented. Never blocks.
+    void collectRetiredResources();
+
+    // Call after queueing the present of a frame that acquired imageIndex and signals renderValue on the render
+    // timeline. Tells collectRetiredResources when the presentation engine is done with retired swapchains.
+    void onImagePresented(uint32_t imageIndex, uint64_t renderValue);
+
+    // Destroys the current and all retired resources. Only call once the device is idle.
     void destroySwapchain();
 
     void createImageViews();
@@ -0,0 +1,43 @@
+//
+// Created by Saman on 14.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_VULKAN_TIMELINE_H
+#define REALTIME_CELL_COLLAPSE_VULKAN_TIMELINE_H
+
+#include "preprocessor.h"
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// https://www.khronos.org/blog/vulkan-timeline-semaphores
+namespace VulkanTimeline {
+    struct Timeline {
+        VkSemaphore semaphore = nullptr;
+        // The highest value any queue submission so far has been asked to signal
+        uint64_t lastSubmittedValue = 0;
+
+        // Reserve the value that the next submission on this timeline will signal
+        uint64_t next();
+    };
+
+    // Signalled by mesh uploads on the transfer queue
+    extern Timeline upload;
+    // Signalled by every frame submitted to the graphics queue
+    extern Timeline render;
+
+    void create();
+
+    void destroy();
+
+    VkSemaphore createTimelineSemaphore(uint64_t initialValue = 0);
+
+    // Non-blocking query of how far the GPU has progressed on a timeline
+    uint64_t completedValue(const Timeline &timeline);
+
+    bool isReached(const Timeline &timeline, uint64_t value);
+
+    void wait(const Timeline &timeline, uint64_t value, uint64_t timeout = UINT64_MAX);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_VULKAN_TIMELINE_H
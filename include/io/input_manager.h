@@ -21,9 +21,7 @@ public:
 
     virtual void update(sec delta, ECS &ecs) override;
 
-    static inline bool EvaluatorInputManagerEntity(const Components &components) {
-        return components.isAlive() && components.inputState != nullptr;
-    };
+    static inline Query QueryInputManagerEntity{signatureOf<InputState>()};
 
 private:
     static void _callback(GLFWwindow *window, int key, int scancode, int action, int mods);
@@ -6,6 +6,7 @@
 #define REALTIME_CELL_COLLAPSE_TRANSFORMER_H
 
 #include "preprocessor.h"
+#include "ecs/change_tracking.h"
 
 #include <glm/glm.hpp>
 
@@ -21,6 +22,9 @@ public:
 
     glm::mat4 forward{1.0f}, inverse{1.0f};
 
+    // Stamped by every transformation
+    uint64_t version = ChangeTracking::stamp();
+
     [[nodiscard]] glm::vec3 getPosition() const;
 };
 
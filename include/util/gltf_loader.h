@@ -0,0 +1,40 @@
+//
+// Created by Saman on 19.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_GLTF_LOADER_H
+#define REALTIME_CELL_COLLAPSE_GLTF_LOADER_H
+
+#include "preprocessor.h"
+#include "util/importer.h"
+
+#include <string>
+#include <cstddef>
+#include <cstring>
+
+// Native reader for binary glTF (.glb) triangle meshes, reading straight from a memory mapped file.
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html
+namespace GltfLoader {
+    // Typed view of an accessor inside the BIN chunk. Elements may be interleaved with other attributes.
+    template<typename T>
+    struct AccessorView {
+        const std::byte *data = nullptr;
+        size_t count = 0;
+        size_t stride = sizeof(T);
+
+        [[nodiscard]] bool isTightlyPacked() const { return stride == sizeof(T); }
+
+        // Copy, as the BIN chunk gives no alignment guarantees for T
+        T operator[](size_t i) const {
+            T out;
+            memcpy(&out, data + i * stride, sizeof(T));
+            return out;
+        }
+    };
+
+    // Returns false if the file is not a GLB, or uses anything this path does not support.
+    // Use Assimp in that case.
+    bool loadGlb(const std::string &filename, Importinator::Mesh &out);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_GLTF_LOADER_H
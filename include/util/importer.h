@@ -8,18 +8,56 @@
 #include "preprocessor.h"
 #include "graphics/vertex.h"
 
+#include <glm/glm.hpp>
 #include <vector>
 #include <string>
 
 namespace Importinator {
+    // Contiguous part of a merged mesh, one per source mesh or glTF primitive.
+    // Indices are already rebased onto the merged vertex array.
+    struct Submesh {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    // View independent simplification of a whole mesh, by clustering vertices on a grid
+    struct Lod {
+        float cellSize = 0.0f; // Grid cell size in model space
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
     struct Mesh{
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
+        std::vector<Submesh> submeshes;
+        std::vector<Lod> lods; // Finest first
+        // Axis aligned bounding box of the vertices. Filled by MeshProcessing::process, or by the mesh cache.
+        glm::vec3 boundsMin{0.0f};
+        glm::vec3 boundsMax{0.0f};
+        // False if the source file did not provide them
+        bool hasNormals = true;
+        bool hasTangents = true;
+    };
+
+    // Steps of our own post-processing, see MeshProcessing. They replace the equivalent Assimp steps.
+    enum PostProcessing : uint32_t {
+        POST_PROCESS_WELD_VERTICES = 1 << 0,
+        POST_PROCESS_GENERATE_NORMALS = 1 << 1, // Only if missing
+        POST_PROCESS_GENERATE_TANGENTS = 1 << 2, // Only if missing
+        POST_PROCESS_LOD_CHAIN = 1 << 3,
+        POST_PROCESS_SPATIAL_ORDER = 1 << 4,
+        POST_PROCESS_ALL = POST_PROCESS_WELD_VERTICES | POST_PROCESS_GENERATE_NORMALS | POST_PROCESS_GENERATE_TANGENTS |
+                           POST_PROCESS_LOD_CHAIN | POST_PROCESS_SPATIAL_ORDER
     };
 
     std::vector<char> readFile(const std::string &filename);
 
-    Mesh importMesh(const std::string &filename);
+    // Uses the binary mesh cache if there is a valid one, and creates it otherwise.
+    // GLB files are read natively, everything else goes through Assimp.
+    Mesh importMesh(const std::string &filename, uint32_t postProcessing = POST_PROCESS_ALL);
 }
 
 #endif //REALTIME_CELL_COLLAPSE_IMPORTER_H
@@ -0,0 +1,42 @@
+//
+// Created by Saman on 19.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_JSON_H
+#define REALTIME_CELL_COLLAPSE_JSON_H
+
+#include "preprocessor.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <optional>
+
+// Minimal JSON reader. Just enough for glTF headers, no writer.
+namespace Json {
+    enum class Type {
+        NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT
+    };
+
+    struct Value {
+        Type type = Type::NUL;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string{};
+        std::vector<Value> array{};
+        std::vector<std::pair<std::string, Value>> object{};
+
+        // nullptr if this is not an object or the key is missing
+        [[nodiscard]] const Value *find(std::string_view key) const;
+
+        [[nodiscard]] double numberOr(std::string_view key, double fallback) const;
+
+        [[nodiscard]] bool isNumber() const { return type == Type::NUMBER; }
+    };
+
+    // Empty if the text is not valid JSON
+    std::optional<Value> parse(std::string_view text);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_JSON_H
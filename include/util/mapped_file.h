@@ -0,0 +1,48 @@
+//
+// Created by Saman on 18.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MAPPED_FILE_H
+#define REALTIME_CELL_COLLAPSE_MAPPED_FILE_H
+
+#include "preprocessor.h"
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The OS pages data in on first access, instead of copying it upfront.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Returns false if the file does not exist or can not be mapped
+    bool open(const std::string &filename);
+
+    void close();
+
+    [[nodiscard]] const std::byte *data() const { return this->mappedData; }
+
+    [[nodiscard]] size_t size() const { return this->mappedSize; }
+
+    [[nodiscard]] bool isOpen() const { return this->mappedData != nullptr; }
+
+private:
+    const std::byte *mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+#endif //REALTIME_CELL_COLLAPSE_MAPPED_FILE_H
@@ -0,0 +1,30 @@
+//
+// Created by Saman on 18.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_CACHE_H
+#define REALTIME_CELL_COLLAPSE_MESH_CACHE_H
+
+#include "preprocessor.h"
+#include "util/importer.h"
+
+#include <glm/glm.hpp>
+#include <string>
+
+// Post-processed meshes stored next to their source file, so Assimp only runs on the first launch.
+// Invalidated by a new format version, a different Vertex layout, other post-processing, or a changed source file.
+namespace MeshCache {
+    extern const uint32_t VERSION;
+
+    std::string getCachePath(const std::string &sourceFile);
+
+    // Returns false if there is no valid cache for the source file and post-processing steps
+    bool load(const std::string &sourceFile, uint32_t postProcessing, Importinator::Mesh &out);
+
+    // Reads just the bounding box of a valid cache, without loading the mesh
+    bool loadBounds(const std::string &sourceFile, uint32_t postProcessing, glm::vec3 &min, glm::vec3 &max);
+
+    void store(const std::string &sourceFile, uint32_t postProcessing, const Importinator::Mesh &mesh);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_CACHE_H
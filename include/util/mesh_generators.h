@@ -0,0 +1,31 @@
+//
+// Created by Saman on 22.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_GENERATORS_H
+#define REALTIME_CELL_COLLAPSE_MESH_GENERATORS_H
+
+#include "preprocessor.h"
+#include "util/importer.h"
+
+#include <string>
+#include <optional>
+
+// Procedural meshes of arbitrary size, for scaling measurements without assets.
+// All of them are generated in parallel on the ThreadPool, and come with normals but without tangents.
+namespace MeshGenerators {
+    // Unit geodesic sphere. Every icosahedron face is split into frequency^2 triangles, 20 * frequency^2 in total.
+    Importinator::Mesh icosphere(uint32_t frequency);
+
+    // Square heightfield of 2 * resolution^2 triangles in the XY plane, displaced towards -Z, so it faces the camera
+    Importinator::Mesh terrain(uint32_t resolution, float size = 2.0f, float height = 0.2f);
+
+    // countX * countY copies of a mesh in a grid in the XY plane, centered on the origin. One submesh per copy.
+    Importinator::Mesh tiled(const Importinator::Mesh &mesh, uint32_t countX, uint32_t countY, float spacing);
+
+    // Parses "icosphere:<frequency>", "terrain:<resolution>" or "tiled:<model file>:<count per axis>".
+    // The result is run through MeshProcessing like an imported mesh.
+    std::optional<Importinator::Mesh> fromSpec(const std::string &spec);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_GENERATORS_H
@@ -0,0 +1,51 @@
+//
+// Created by Saman on 20.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_MESH_PROCESSING_H
+#define REALTIME_CELL_COLLAPSE_MESH_PROCESSING_H
+
+#include "preprocessor.h"
+#include "util/importer.h"
+#include "graphics/mesh_cluster.h"
+
+#include <vector>
+
+// Import post-processing, running on the ThreadPool
+namespace MeshProcessing {
+    // Merges vertices that share all attributes, with positions compared within a tolerance relative to the mesh size
+    void weldVertices(Importinator::Mesh &mesh);
+
+    // Area weighted smooth normals
+    void generateNormals(Importinator::Mesh &mesh);
+
+    // Tangents and bitangents from the first UV channel, orthogonalized against the normals
+    void generateTangents(Importinator::Mesh &mesh);
+
+    // Sorts the vertices of every submesh along a Morton curve, and its triangles by their lowest vertex,
+    // so that walking the index buffer touches memory mostly sequentially
+    void reorderSpatially(Importinator::Mesh &mesh);
+
+    // Simulated misses of a 32KiB, 8-way set associative cache with 64 byte lines,
+    // when reading one element of elementSize bytes per index
+    size_t countCacheMisses(const std::vector<uint32_t> &indices, size_t elementSize);
+
+    // Splits the triangles into runs of consecutive triangles, with bounding spheres and normal cones for GPU culling.
+    // The first cluster covers the whole mesh and never gets cone culled. Index ranges are relative to indices.
+    // Works best after reorderSpatially, which keeps consecutive triangles close together.
+    std::vector<MeshCluster> buildClusters(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+    // How many clusters buildClusters returns for a mesh with indexCount indices
+    size_t getClusterCount(size_t indexCount);
+
+    // Clusters vertices on grids of doubling cell size, until the mesh is tiny or there are MAX_LODS levels
+    void generateLodChain(Importinator::Mesh &mesh);
+
+    // Axis aligned bounding box of the vertices
+    void computeBounds(Importinator::Mesh &mesh);
+
+    // Runs the selected Importinator::PostProcessing steps, and computes the bounds of the result
+    void process(Importinator::Mesh &mesh, uint32_t steps);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_MESH_PROCESSING_H
@@ -0,0 +1,38 @@
+//
+// Created by Saman on 30.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_RANGE_ALLOCATOR_H
+#define REALTIME_CELL_COLLAPSE_RANGE_ALLOCATOR_H
+
+#include "preprocessor.h"
+
+#include <cstdint>
+#include <map>
+
+/**
+ * Hands out ranges of [0, capacity), e.g. elements of a GPU buffer that is shared by many meshes.
+ * First fit over a free list, which is merged with its neighbours on free. Not thread safe.
+ */
+class RangeAllocator {
+public:
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+    explicit RangeAllocator(uint32_t capacity = 0);
+
+    // INVALID_OFFSET if there is no free range of that size
+    uint32_t allocate(uint32_t size);
+
+    void free(uint32_t offset, uint32_t size);
+
+    [[nodiscard]] uint32_t getCapacity() const;
+
+    [[nodiscard]] uint32_t getFreeSize() const;
+
+private:
+    uint32_t capacity;
+    uint32_t freeSize;
+    std::map<uint32_t, uint32_t> freeRanges{}; // Offset -> size
+};
+
+#endif //REALTIME_CELL_COLLAPSE_RANGE_ALLOCATOR_H
@@ -0,0 +1,36 @@
+//
+// Created by Saman on 20.09.23.
+//
+
+#ifndef REALTIME_CELL_COLLAPSE_THREAD_POOL_H
+#define REALTIME_CELL_COLLAPSE_THREAD_POOL_H
+
+#include "preprocessor.h"
+
+#include <functional>
+#include <future>
+#include <cstdint>
+
+// Shared worker threads for data parallel work like mesh processing
+namespace ThreadPool {
+    // 0 uses one worker per hardware thread, minus the calling thread
+    void create(uint32_t workerCount = 0);
+
+    void destroy();
+
+    // Workers plus the calling thread, which takes part in parallelFor
+    uint32_t getThreadCount();
+
+    std::future<void> submit(std::function<void()> task);
+
+    // Number of chunks parallelFor splits a range of this size into. At most getThreadCount().
+    uint32_t getChunkCount(size_t count, size_t minChunkSize = 1024);
+
+    // Runs body(begin, end, chunk) over [0, count) in getChunkCount() contiguous chunks and blocks until all are done.
+    // The chunk index can be used to address per-thread scratch buffers.
+    // Runs inline if the pool was not created, or if called from a worker.
+    void parallelFor(size_t count, const std::function<void(size_t begin, size_t end, uint32_t chunk)> &body,
+                     size_t minChunkSize = 1024);
+}
+
+#endif //REALTIME_CELL_COLLAPSE_THREAD_POOL_H
@@ -1,11 +1,20 @@
 #version 450
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
+struct Instance {
+    mat4 model; // Model to world
+    mat4 normal; // transpose(inverse(model)), upper 3x3 only
+};
+
+// Every drawn instance of every mesh. Indexed by gl_InstanceIndex, which starts at the draw's firstInstance.
+layout(std430, set = 0, binding = 1) readonly buffer InstanceBuffer {
+    Instance instances[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
@@ -18,30 +27,17 @@ layout(location = 1) out vec4 fragWorldPos;
 layout(location = 2) out vec3 fragColor;
 layout(location = 3) out vec3 fragNormal;
 layout(location = 4) out vec3 fragUVW;
-layout(location = 5) out mat4 modelTransform;
-
-//#define INSTANCED_RENDERING
 
 void main() {
-    mat4 model  = ubo.model;
-
-#ifdef INSTANCED_RENDERING
-    model += mat4 (
-    0, 0, 0, 0,
-    0, 0, 0, 0,
-    0, 0, 0, 0,
-    (gl_InstanceIndex / 5 - 2) * 5, (gl_InstanceIndex % 5 - 2) * 5, 0, 0
-    );
-#endif
-
-    vec4 posWS = model * vec4(inPosition, 1.0);
+    Instance instance = instances[gl_InstanceIndex];
+
+    vec4 posWS = instance.model * vec4(inPosition, 1.0);
     vec4 posSS = ubo.proj * ubo.view * posWS;
     gl_Position = posSS;
 
     fragPos = posSS;
     fragWorldPos = posWS;
     fragColor = inColor;
-    fragNormal = inNormal;
+    fragNormal = mat3(instance.normal) * inNormal;
     fragUVW = inUVW;
-    modelTransform = model;
 }
\ No newline at end of file
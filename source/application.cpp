@@ -7,44 +7,66 @@
 #include "ecs/entities/dense_sphere.h"
 #include "ecs/entities/monkey.h"
 #include "ecs/entities/camera.h"
+#include "ecs/entities/mesh_instance_entity.h"
+#include "ecs/entities/mesh_proxy.h"
+#include "ecs/entities/generated_mesh.h"
+#include "util/mesh_generators.h"
 #include "ecs/systems/camera_controller.h"
 #include "ecs/systems/sphere_controller.h"
 #include "ecs/systems/mesh_simplifier_controller.h"
 #include "util/performance_logging.h"
+#include "util/thread_pool.h"
+#include "graphics/vulkan/vulkan_buffers.h"
 
 #include <iomanip>
 
 void Application::run() {
-    do {
-        this->exitAfterMainLoop = true;
-        init();
-        mainLoop();
-        destroy();
-    } while (this->exitAfterMainLoop == false);
+    init();
+    mainLoop();
+    destroy();
 }
 
 void Application::init() {
     INF "Creating Application" ENDL;
 
+    this->initTimestamp = Timer::now();
+    this->timeToFirstFrame = 0;
+
+    ThreadPool::create();
     this->ecs.create();
     this->windowManager.create(this->title);
     this->inputManager.create(this->windowManager.window, this->ecs);
     this->renderer.create(this->title, this->windowManager.window);
 
     renderer.getUiState()->isMonkeyMesh = this->monkeyMode;
+    createSystems();
 
     // Entities
     Camera camera{};
     camera.components.isMainCamera = true;
     camera.upload(this->ecs);
 
-    if (this->monkeyMode) {
-        Monkey monkey{};
-        monkey.upload(this->ecs);
-    } else {
-        DenseSphere sphere{};
-        sphere.upload(this->ecs);
+    // Show a box until the real mesh is ready, so the first frame does not wait for the import
+    // Generated meshes have no model file, so they get the unit sized box
+    const bool isGenerated = !this->monkeyMode && !this->generatedMeshSpec.empty();
+    MeshProxy proxy = isGenerated ? MeshProxy{}
+                                  : MeshProxy{this->monkeyMode ? Monkey::MODEL_PATH : DenseSphere::MODEL_PATH};
+    this->mainMesh = proxy.upload(this->ecs);
+    loadMainMesh();
+
+#ifdef INSTANCED_RENDERING
+    // Grid in the XY plane, centered on the original mesh
+    const float spacing = 5.0f;
+    const float gridOffset = static_cast<float>(INSTANCE_GRID_SIZE - 1) * spacing * 0.5f;
+    for (uint32_t x = 0; x < INSTANCE_GRID_SIZE; ++x) {
+        for (uint32_t y = 0; y < INSTANCE_GRID_SIZE; ++y) {
+            MeshInstanceEntity instance{this->mainMesh, glm::vec3(static_cast<float>(x) * spacing - gridOffset,
+                                                            static_cast<float>(y) * spacing - gridOffset,
+                                                            0.0f)};
+            instance.upload(this->ecs);
+        }
     }
+#endif
 }
 
 void Application::mainLoop() {
@@ -52,7 +74,7 @@ void Application::mainLoop() {
 
         // Input
         this->inputManager.update(this->deltaTime, this->ecs);
-        auto &inputState = *ecs.requestEntities(InputController::EvaluatorInputManagerEntity)[0]->inputState;
+        auto &inputState = ecs.get<InputState>(ecs.getFirst(InputController::QueryInputManagerEntity));
         if (inputState.closeWindow == IM_DOWN_EVENT)
             this->windowManager.close();
         if (inputState.toggleFullscreen == IM_DOWN_EVENT)
@@ -64,26 +86,30 @@ void Application::mainLoop() {
         uiState->cpuWaitTime = this->currentCpuWaitTime;
 
         if (uiState->switchMesh) {
-            this->exitAfterMainLoop = false;
-            this->monkeyMode = !this->monkeyMode;
-            this->windowManager.close();
+            uiState->switchMesh = false;
+            switchMesh();
         }
+        finishLoadingMainMesh();
 
-        auto cameraPos = this->ecs.requestEntities(CameraController::EvaluatorActiveCamera)[0]
-                ->transform->getPosition();
+        auto cameraPos = this->ecs.get<Transformer4>(this->ecs.getFirst(CameraController::QueryActiveCamera))
+                .getPosition();
         uiState->cameraZ = cameraPos.z;
 
         // Systems
-        CameraController::update(this->deltaTime, this->ecs);
-        SphereController::update(this->deltaTime, this->ecs);
-        if (uiState->runMeshSimplifier)
-            MeshSimplifierController::update(this->ecs, &uiState->meshSimplifierTimeTaken,
-                                             &uiState->meshSimplifierFramesTaken);
+        this->scheduler.run(this->deltaTime, this->ecs);
 
         // Render
         if (uiState->returnToOriginalMeshBuffer)
-            this->renderer.resetMesh();
+            this->renderer.resetMesh(this->ecs);
         this->currentCpuWaitTime = this->renderer.draw(this->deltaTime, this->ecs);
+        this->ecs.flushRemovals();
+        if (this->timeToFirstFrame == 0) {
+            // From the start of init, including window, device, pipeline and mesh creation
+            this->timeToFirstFrame = Timer::duration(this->initTimestamp, Timer::now());
+            INF "Time to first frame: " << this->timeToFirstFrame << " seconds" ENDL;
+        }
+        uiState->timeToFirstFrame = this->timeToFirstFrame;
+        uiState->timeToInteractive = this->timeToInteractive;
 
         // Benchmark
         auto time = Timer::now();
@@ -99,9 +125,117 @@ void Application::mainLoop() {
     }
 }
 
+void Application::createSystems() {
+    // Input is polled on the main thread, since GLFW requires that. Everything below reads its result.
+    Query &input = InputController::QueryInputManagerEntity;
+
+    this->scheduler.add({
+            .name = "CameraController",
+            .access = {{.query = &CameraController::QueryActiveCamera, .writes = signatureOf<Transformer4>()},
+                       {.query = &input, .reads = signatureOf<InputState>()}},
+            .update = [](sec delta, ECS &ecs) { CameraController::update(delta, ecs); }
+    });
+
+    this->scheduler.add({
+            .name = "SphereController",
+            .access = {{.query = &SphereController::QueryRotatingSphere, .writes = signatureOf<Transformer4>()},
+                       {.query = &input, .reads = signatureOf<InputState>()}},
+            .update = [](sec delta, ECS &ecs) { SphereController::update(delta, ecs); }
+    });
+
+    this->scheduler.add({
+            .name = "MeshSimplifierController",
+            .access = {{.query = &MeshSimplifierController::QueryToSimplify,
+                               .reads = signatureOf<RenderMesh, Transformer4>(),
+                               .writes = signatureOf<RenderMeshSimplifiable>()},
+                       {.query = &CameraController::QueryActiveCamera,
+                               .reads = signatureOf<Projector, Transformer4>()}},
+            .update = [this](sec, ECS &ecs) {
+                auto uiState = this->renderer.getUiState();
+                if (uiState->runMeshSimplifier)
+                    MeshSimplifierController::update(ecs, &uiState->meshSimplifierTimeTaken,
+                                                     &uiState->meshSimplifierFramesTaken);
+            }
+    });
+}
+
+void Application::loadMainMesh() {
+    this->mainMeshLoadingStartTime = Timer::now();
+
+    // A dedicated thread rather than a ThreadPool task, so the import itself can still use the whole pool
+    const bool loadMonkey = this->monkeyMode;
+    const std::string spec = this->generatedMeshSpec;
+    this->mainMeshLoading = std::async(std::launch::async, [loadMonkey, spec]() -> Components {
+        if (loadMonkey) {
+            Monkey monkey{};
+            return std::move(monkey.components);
+        } else if (!spec.empty()) {
+            auto mesh = MeshGenerators::fromSpec(spec);
+            if (!mesh.has_value()) {
+                THROW("Invalid mesh generator spec " + spec);
+            }
+            // Fail loudly, rather than replacing the proxy with a mesh that can never be drawn
+            if (!VulkanBuffers::canEverFitMesh(mesh->vertices.size(), mesh->indices.size())) {
+                THROW("Mesh generator spec " + spec + " makes " + std::to_string(mesh->vertices.size()) +
+                      " vertices and " + std::to_string(mesh->indices.size()) +
+                      " indices, more than the mesh buffers can hold");
+            }
+            GeneratedMesh generated{std::move(*mesh)};
+            return std::move(generated.components);
+        } else {
+            DenseSphere sphere{};
+            return std::move(sphere.components);
+        }
+    });
+}
+
+void Application::finishLoadingMainMesh() {
+    if (!this->mainMeshLoading.valid() ||
+        this->mainMeshLoading.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    Components components = this->mainMeshLoading.get(); // Rethrows import errors
+
+    // Insert first, remove after. The renderer uploads the new mesh and releases the old one in the same frame.
+    const EntityHandle oldMesh = this->mainMesh;
+    this->mainMesh = this->ecs.insert(components);
+
+    this->ecs.forEach<MeshInstance>(Application::QueryInstances, [&](const EntityHandle &, MeshInstance &instance) {
+        if (instance.parent == oldMesh) {
+            instance.parent = this->mainMesh;
+        }
+    });
+
+    this->ecs.remove(oldMesh);
+
+    auto uiState = this->renderer.getUiState();
+    uiState->isMonkeyMesh = this->monkeyMode;
+    if (this->timeToInteractive == 0) {
+        // From the start of init until the full mesh replaces the proxy. Uploading it is part of the next frame.
+        this->timeToInteractive = Timer::duration(this->initTimestamp, Timer::now());
+        INF "Time to interactive: " << this->timeToInteractive << " seconds" ENDL;
+    } else {
+        uiState->meshSwitchTimeTaken = Timer::duration(this->mainMeshLoadingStartTime, Timer::now());
+        INF "Switched mesh in " << uiState->meshSwitchTimeTaken << " seconds" ENDL;
+    }
+}
+
+void Application::switchMesh() {
+    if (this->mainMeshLoading.valid()) {
+        return; // Still loading
+    }
+
+    this->monkeyMode = !this->monkeyMode;
+    loadMainMesh();
+}
+
 void Application::destroy() {
     INF "Destroying Application" ENDL;
 
+    if (this->mainMeshLoading.valid()) {
+        this->mainMeshLoading.wait();
+    }
+
     CameraController::destroy();
     SphereController::destroy();
     MeshSimplifierController::destroy();
@@ -110,4 +244,5 @@ void Application::destroy() {
     this->inputManager.destroy();
     this->windowManager.destroy();
     this->ecs.destroy();
+    ThreadPool::destroy();
 }
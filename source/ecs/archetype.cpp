@@ -0,0 +1,58 @@
+//
+// Created by Saman on 24.09.23.
+//
+
+#include "ecs/archetype.h"
+
+#include <type_traits>
+
+template<size_t... I>
+void createColumns(std::array<std::unique_ptr<ComponentColumn>, COMPONENT_TYPE_COUNT> &columns,
+                   const Signature &signature, std::index_sequence<I...>) {
+    ([&] {
+        using T = std::tuple_element_t<I, ComponentTypes>;
+        if constexpr (!std::is_empty_v<T>) {
+            if (signature[I]) columns[I] = std::make_unique<Column<T>>();
+        }
+    }(), ...);
+}
+
+Archetype::Archetype(const Signature &signature) : signature(signature) {
+    createColumns(this->columns, signature, std::make_index_sequence<COMPONENT_TYPE_COUNT>{});
+}
+
+uint32_t Archetype::insert(EntityHandle entity, Components &components) {
+    this->entities.push(std::move(entity));
+    if (components.inputState != nullptr) getColumn<InputState>().push(std::move(*components.inputState));
+    if (components.renderMesh != nullptr) getColumn<RenderMesh>().push(std::move(*components.renderMesh));
+    if (components.renderMeshSimplifiable != nullptr) {
+        getColumn<RenderMeshSimplifiable>().push(std::move(*components.renderMeshSimplifiable));
+    }
+    if (components.instance != nullptr) getColumn<MeshInstance>().push(std::move(*components.instance));
+    if (components.transform != nullptr) getColumn<Transformer4>().push(std::move(*components.transform));
+    if (components.camera != nullptr) getColumn<Projector>().push(std::move(*components.camera));
+
+    // The bundle is spent
+    components = Components{};
+    return this->rowCount++;
+}
+
+uint32_t Archetype::moveRowTo(uint32_t row, Archetype &target) {
+    for (uint32_t i = 0; i < COMPONENT_TYPE_COUNT; ++i) {
+        if (this->columns[i] != nullptr && target.columns[i] != nullptr) {
+            this->columns[i]->moveTo(row, *target.columns[i]);
+        }
+    }
+    target.entities.push(EntityHandle{this->entities[row]});
+    return target.rowCount++;
+}
+
+uint32_t Archetype::swapRemove(uint32_t row) {
+    for (auto &column: this->columns) {
+        if (column != nullptr) column->swapRemove(row);
+    }
+    this->entities.swapRemove(row);
+    --this->rowCount;
+
+    return row < this->rowCount ? this->entities[row].index : UINT32_MAX;
+}
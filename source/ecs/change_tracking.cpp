@@ -0,0 +1,18 @@
+//
+// Created by Saman on 28.09.23.
+//
+
+#include "ecs/change_tracking.h"
+
+#include <atomic>
+
+// Starts at 0, so a version of 0 means unchanged since startup
+static std::atomic<uint64_t> latestVersion = 0;
+
+uint64_t ChangeTracking::stamp() {
+    return latestVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+uint64_t ChangeTracking::current() {
+    return latestVersion.load(std::memory_order_relaxed);
+}
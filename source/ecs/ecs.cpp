@@ -4,7 +4,6 @@
 
 #include "ecs/ecs.h"
 #include "io/printer.h"
-#include "ecs/entities/dense_sphere.h"
 
 #include <stdexcept>
 
@@ -12,49 +11,146 @@ void ECS::create() {
     INF "Creating ECS" ENDL;
 }
 
-uint32_t ECS::insert(Components &entityComponents) {
-    for (uint32_t i = 0; i < this->entities.size(); ++i) {
-        if (this->entities[i].willDestroy) {
-            destroyReferences(i); // Clean up old references before overriding pointers
-        }
-        if (this->entities[i].isDestroyed) {
-            entityComponents.index = i;
-            this->entities[i] = std::move(entityComponents); // Move reference here -> param can't be const
-            return i;
-        }
+EntityHandle ECS::insert(Components &entityComponents) {
+    Archetype &archetype = getArchetype(entityComponents.getSignature());
+
+    EntityHandle entity{};
+    if (!this->freeIndices.empty()) {
+        entity.index = this->freeIndices.back();
+        this->freeIndices.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(this->records.size());
+        this->records.emplace_back();
     }
 
-    auto index = this->entities.size() - 1;
-    entityComponents.index = index;
-    this->entities.push_back(std::move(entityComponents));
-    return index;
+    EntityRecord &record = this->records[entity.index];
+    entity.generation = record.generation;
+    record = {
+            .archetype = &archetype,
+            .row = archetype.insert(entity, entityComponents),
+            .generation = entity.generation
+    };
+    return entity;
 }
 
 void ECS::destroy() {
     INF "Destroying ECS" ENDL;
 
-    for (uint32_t i = 0; i < this->entities.size(); ++i) {
-        destroyReferences(i);
+    if (this->pinCount > 0) {
+        DBG "Destroying the ECS while " << this->pinCount << " entities are pinned" ENDL;
     }
+
+    this->pendingRemovals.clear();
+    this->freeIndices.clear();
+    this->records.clear();
+    this->archetypesBySignature.clear();
+    this->archetypes.clear();
 }
 
-void ECS::remove(const uint32_t &index) {
-    this->entities[index].willDestroy = true;
+void ECS::remove(const EntityHandle &entity) {
+    if (!isAlive(entity)) return;
+
+    this->records[entity.index].willDestroy = true;
+    this->pendingRemovals.push_back(entity);
 }
 
-void ECS::destroyReferences(const uint32_t &index) {
-    this->entities[index].destroy();
+void ECS::flushRemovals() {
+    if (this->pinCount > 0) return;
+
+    for (const EntityHandle &entity: this->pendingRemovals) {
+        auto &record = this->records[entity.index];
+
+        const uint32_t moved = record.archetype->swapRemove(record.row);
+        if (moved != UINT32_MAX) {
+            this->records[moved].row = record.row;
+        }
+
+        record = {.generation = record.generation + 1, .isDestroyed = true};
+        this->freeIndices.push_back(entity.index);
+    }
+    this->pendingRemovals.clear();
 }
 
-std::vector<Components *>
-ECS::requestEntities(const std::function<bool(const Components &)> &evaluator) {
-    std::vector<Components *> out{};
+bool ECS::hasPendingRemovals() const {
+    return !this->pendingRemovals.empty();
+}
+
+const ECS::EntityRecord *ECS::resolve(const EntityHandle &entity) const {
+    if (entity.index >= this->records.size()) return nullptr;
+    const EntityRecord &record = this->records[entity.index];
+    if (record.isDestroyed || record.generation != entity.generation) return nullptr;
+    return &record;
+}
+
+bool ECS::isAlive(const EntityHandle &entity) const {
+    const EntityRecord *record = resolve(entity);
+    return record != nullptr && !record->willDestroy;
+}
 
-    for (auto &component: this->entities) {
-        if (evaluator(component)) {
-            out.push_back(&component);
+bool ECS::hasComponents(const EntityHandle &entity, const Signature &required) const {
+    return isAlive(entity) && (this->records[entity.index].archetype->signature & required) == required;
+}
+
+void ECS::pin(const EntityHandle &entity) {
+    if (resolve(entity) == nullptr) {
+        THROW("Can not pin entity " + std::to_string(entity.index) + ", it does not exist");
+    }
+    ++this->pinCount;
+}
+
+void ECS::unpin(const EntityHandle &) {
+    --this->pinCount;
+}
+
+bool ECS::canOverlap(Query &a, Query &b) {
+    for (Archetype *archetype: getArchetypes(a)) {
+        if (b.matches(archetype->signature)) return true;
+    }
+    return false;
+}
+
+EntityHandle ECS::getFirst(Query &query) {
+    for (Archetype *archetype: getArchetypes(query)) {
+        for (uint32_t row = 0; row < archetype->size(); ++row) {
+            const EntityHandle &entity = archetype->entities[row];
+            if (!this->records[entity.index].willDestroy) return entity;
+        }
+    }
+    THROW("No entity matches the query");
+}
+
+const std::vector<Archetype *> &ECS::getArchetypes(Query &query) {
+    if (query.checkedArchetypeCount.load(std::memory_order_acquire) != this->archetypes.size()) {
+        std::lock_guard lock(query.updateMutex);
+        for (size_t i = query.checkedArchetypeCount; i < this->archetypes.size(); ++i) {
+            if (query.matches(this->archetypes[i]->signature)) {
+                query.archetypes.push_back(this->archetypes[i].get());
+            }
         }
+        query.checkedArchetypeCount.store(this->archetypes.size(), std::memory_order_release);
     }
+    return query.archetypes;
+}
 
-    return out;
-}
\ No newline at end of file
+void ECS::relocate(const EntityHandle &entity, Archetype &target, uint32_t row) {
+    EntityRecord &record = this->records[entity.index];
+    const uint32_t moved = record.archetype->swapRemove(record.row);
+    if (moved != UINT32_MAX) {
+        this->records[moved].row = record.row;
+    }
+
+    record.archetype = &target;
+    record.row = row;
+}
+
+Archetype &ECS::getArchetype(const Signature &signature) {
+    auto found = this->archetypesBySignature.find(signature);
+    if (found != this->archetypesBySignature.end()) {
+        return *found->second;
+    }
+
+    DBG "Creating archetype " << signature.to_string() ENDL;
+    auto &archetype = this->archetypes.emplace_back(std::make_unique<Archetype>(signature));
+    this->archetypesBySignature[signature] = archetype.get();
+    return *archetype;
+}
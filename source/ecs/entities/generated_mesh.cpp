@@ -0,0 +1,45 @@
+//
+// Created by Saman on 22.09.23.
+//
+
+#include "ecs/entities/generated_mesh.h"
+#include "util/thread_pool.h"
+#include "graphics/colors.h"
+
+#include <algorithm>
+#include <vector>
+
+GeneratedMesh::GeneratedMesh(Importinator::Mesh mesh) {
+    this->components.renderMesh = std::make_unique<RenderMesh>();
+    this->components.renderMesh->indices = std::move(mesh.indices);
+    this->components.renderMesh->vertices = std::move(mesh.vertices);
+    this->components.renderMesh->submeshes = std::move(mesh.submeshes);
+    this->components.renderMesh->lods = std::move(mesh.lods);
+    this->components.renderMesh->setBounds(mesh.boundsMin, mesh.boundsMax);
+
+    // Generated meshes can be huge, so the colors are assigned in parallel.
+    // The LODs get colors as well, since the simplifier starts from them once the camera moves away.
+    std::vector<std::vector<Vertex> *> vertexArrays{&this->components.renderMesh->vertices};
+    for (auto &lod: this->components.renderMesh->lods) {
+        vertexArrays.push_back(&lod.vertices);
+    }
+    std::vector<size_t> firstVertices{0}; // Of every array, in one index space across all of them
+    for (const auto *vertices: vertexArrays) {
+        firstVertices.push_back(firstVertices.back() + vertices->size());
+    }
+
+    ThreadPool::parallelFor(firstVertices.back(), [&](size_t begin, size_t end, uint32_t) {
+        size_t array = std::upper_bound(firstVertices.begin(), firstVertices.end(), begin) - firstVertices.begin() - 1;
+        for (size_t i = begin; i < end; ++i) {
+            while (i >= firstVertices[array + 1]) ++array; // Skips empty arrays as well
+            // Linear, the sRGB swapchain encodes on write
+            (*vertexArrays[array])[i - firstVertices[array]].color = Color::random().getRGB();
+        }
+    }, 65536);
+    this->components.renderMeshSimplifiable = std::make_unique<RenderMeshSimplifiable>();
+
+    this->components.transform = std::make_unique<Transformer4>();
+    this->components.transform->scale(1.0f);
+
+    this->components.isRotatingSphere = true;
+}
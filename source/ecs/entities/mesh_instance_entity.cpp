@@ -0,0 +1,13 @@
+//
+// Created by Saman on 16.09.23.
+//
+
+#include "ecs/entities/mesh_instance_entity.h"
+
+MeshInstanceEntity::MeshInstanceEntity(EntityHandle parent, glm::vec3 position) {
+    this->components.instance = std::make_unique<MeshInstance>();
+    this->components.instance->parent = parent;
+
+    this->components.transform = std::make_unique<Transformer4>();
+    this->components.transform->translate(position);
+}
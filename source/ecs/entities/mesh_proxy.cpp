@@ -0,0 +1,57 @@
+//
+// Created by Saman on 21.09.23.
+//
+
+#include "ecs/entities/mesh_proxy.h"
+#include "util/mesh_cache.h"
+
+#include <array>
+
+MeshProxy::MeshProxy() {
+    createBox(glm::vec3(-1.0f), glm::vec3(1.0f));
+}
+
+MeshProxy::MeshProxy(const std::string &modelPath) {
+    glm::vec3 min{-1.0f};
+    glm::vec3 max{1.0f};
+    MeshCache::loadBounds(modelPath, Importinator::POST_PROCESS_ALL, min, max);
+    createBox(min, max);
+}
+
+void MeshProxy::createBox(const glm::vec3 &min, const glm::vec3 &max) {
+    // One quad per face, so every face gets a flat normal
+    const std::array<glm::vec3, 6> normals{
+            glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0),
+            glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+            glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+    };
+
+    this->components.renderMesh = std::make_unique<RenderMesh>();
+    this->components.renderMesh->setBounds(min, max);
+    auto &vertices = this->components.renderMesh->vertices;
+    auto &indices = this->components.renderMesh->indices;
+
+    for (const auto &normal: normals) {
+        // Two axes spanning the face, with u x v == normal for counter clockwise winding
+        const glm::vec3 u = glm::vec3(normal.y != 0 ? 1 : 0, normal.y == 0 ? 1 : 0, 0) * (normal.x + normal.y + normal.z);
+        const glm::vec3 v = glm::cross(normal, u);
+        const auto first = static_cast<uint32_t>(vertices.size());
+
+        for (const glm::vec2 corner: {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)}) {
+            // Corner of the unit cube, mapped onto the bounds
+            const glm::vec3 unit = normal + u * corner.x + v * corner.y;
+            Vertex vertex{};
+            vertex.pos = min + (unit * 0.5f + 0.5f) * (max - min);
+            vertex.color = glm::vec3(0.5f);
+            vertex.normal = normal;
+            vertices.push_back(vertex);
+        }
+
+        for (const uint32_t index: {0u, 1u, 2u, 2u, 3u, 0u}) {
+            indices.push_back(first + index);
+        }
+    }
+
+    this->components.transform = std::make_unique<Transformer4>();
+    this->components.isRotatingSphere = true;
+}
@@ -7,13 +7,21 @@
 #include "graphics/colors.h"
 
 Monkey::Monkey() {
-    auto mesh = Importinator::importMesh("resources/models/monkey.glb");
+    auto mesh = Importinator::importMesh(MODEL_PATH);
 
     this->components.renderMesh = std::make_unique<RenderMesh>();
     this->components.renderMesh->indices = std::move(mesh.indices);
     this->components.renderMesh->vertices = std::move(mesh.vertices);
+    this->components.renderMesh->submeshes = std::move(mesh.submeshes);
+    this->components.renderMesh->lods = std::move(mesh.lods);
+    this->components.renderMesh->setBounds(mesh.boundsMin, mesh.boundsMax);
     for (auto &v: this->components.renderMesh->vertices) {
-        v.color = Color::random().getLAB();
+        v.color = Color::random().getRGB(); // Linear, the sRGB swapchain encodes on write
+    }
+    for (auto &lod: this->components.renderMesh->lods) {
+        for (auto &v: lod.vertices) {
+            v.color = Color::random().getRGB();
+        }
     }
     this->components.renderMeshSimplifiable = std::make_unique<RenderMeshSimplifiable>();
 
@@ -4,6 +4,6 @@
 
 #include "ecs/entity.h"
 
-void Entity::upload(ECS &ecs) {
-    ecs.insert(this->components);
+EntityHandle Entity::upload(ECS &ecs) {
+    return ecs.insert(this->components);
 }
\ No newline at end of file
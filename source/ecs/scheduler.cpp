@@ -0,0 +1,59 @@
+//
+// Created by Saman on 27.09.23.
+//
+
+#include "ecs/scheduler.h"
+#include "util/thread_pool.h"
+#include "io/printer.h"
+
+#include <algorithm>
+
+void Scheduler::add(SystemEntry system) {
+    for (const auto &access: system.access) {
+        if (access.query == nullptr) {
+            THROW("System " + system.name + " declares access without a query");
+        }
+    }
+    this->systems.push_back(std::move(system));
+}
+
+bool Scheduler::conflicts(const SystemEntry &a, const SystemEntry &b, ECS &ecs) {
+    for (const auto &accessA: a.access) {
+        for (const auto &accessB: b.access) {
+            const bool sharesComponents = (accessA.writes & (accessB.reads | accessB.writes)).any() ||
+                                          (accessB.writes & accessA.reads).any();
+            if (sharesComponents && ecs.canOverlap(*accessA.query, *accessB.query)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Scheduler::run(sec delta, ECS &ecs) {
+    // The dependency graph is rebuilt every frame, since new archetypes can make queries overlap.
+    // Every system goes into the stage after the last one it conflicts with.
+    this->stages.assign(this->systems.size(), 0);
+    uint32_t stageCount = 0;
+    for (uint32_t i = 0; i < this->systems.size(); ++i) {
+        for (uint32_t j = 0; j < i; ++j) {
+            if (this->stages[j] >= this->stages[i] && conflicts(this->systems[j], this->systems[i], ecs)) {
+                this->stages[i] = this->stages[j] + 1;
+            }
+        }
+        stageCount = std::max(stageCount, this->stages[i] + 1);
+    }
+
+    for (uint32_t stage = 0; stage < stageCount; ++stage) {
+        this->stageSystems.clear();
+        for (uint32_t i = 0; i < this->systems.size(); ++i) {
+            if (this->stages[i] == stage) this->stageSystems.push_back(i);
+        }
+
+        ThreadPool::parallelFor(this->stageSystems.size(), [&](size_t begin, size_t end, uint32_t) {
+            for (size_t i = begin; i < end; ++i) {
+                this->systems[this->stageSystems[i]].update(delta, ecs);
+            }
+        }, 1);
+    }
+}
@@ -6,8 +6,8 @@
 #include "io/printer.h"
 
 void CameraController::update(const sec &delta, ECS &ecs) {
-    auto &camera = *ecs.requestEntities(CameraController::EvaluatorActiveCamera)[0];
-    auto &inputState = *ecs.requestEntities(InputController::EvaluatorInputManagerEntity)[0]->inputState;
+    auto &camera = ecs.get<Transformer4>(ecs.getFirst(CameraController::QueryActiveCamera));
+    auto &inputState = ecs.get<InputState>(ecs.getFirst(InputController::QueryInputManagerEntity));
 
     int move = 0;
     if (inputState.moveForward == IM_DOWN_EVENT ||
@@ -18,7 +18,7 @@ void CameraController::update(const sec &delta, ECS &ecs) {
         inputState.moveBackward == IM_HELD) {
         move -= 1;
     }
-    camera.transform->translate(glm::vec3(0, 0, delta * move));
+    camera.translate(glm::vec3(0, 0, delta * move));
 }
 
 void CameraController::destroy() {
@@ -15,6 +15,8 @@
 #include <unordered_set>
 #include <set>
 #include <algorithm>
+#include <cmath>
+#include <string>
 
 //#define OUTPUT_MAPPINGS
 
@@ -26,6 +28,34 @@ uint32_t simplifiedMeshCalculationThreadFrameCounter = 0;
 chrono_sec_point simplifiedMeshCalculationThreadStartedTime{};
 bool meshCalculationDone = false;
 
+// Camera position at the last simplification, to detect jumps that warrant showing a precomputed LOD right away
+const float LARGE_CAMERA_MOVE = 0.5f; // Relative to the previous distance between camera and mesh
+glm::vec3 lastSimplifiedCameraPosition{};
+bool hasSimplified = false;
+
+// What the last simplification started from. Meshes are only simplified again if anything they depend on changed.
+uint64_t lastSimplifiedVersion = 0;
+uint64_t lastSimplifiedCameraVersion = 0;
+uint32_t lastSimplifiedFramebufferWidth = 0;
+uint32_t lastSimplifiedFramebufferHeight = 0;
+// Set if the last pass left out a mesh that was still being uploaded or locked, so the next pass covers all meshes
+bool hasSkippedMeshes = false;
+
+// Pointers into the ECS columns, gathered on the main thread for the simplification thread.
+// The entities are pinned while the thread works on them, so the pointers stay valid.
+struct CameraComponents {
+    EntityHandle entity{};
+    const Transformer4 *transform = nullptr;
+    const Projector *camera = nullptr;
+};
+
+struct SimplifiableComponents {
+    EntityHandle entity{};
+    const RenderMesh *renderMesh = nullptr;
+    const Transformer4 *transform = nullptr;
+    RenderMeshSimplifiable *renderMeshSimplifiable = nullptr;
+};
+
 struct SVO { // Simplification Vertex Object
     bool set = false;
     uint32_t index = 0;
@@ -124,7 +154,36 @@ private:
     std::vector<uint32_t> indexMappings{};
 };
 
-void simplify(const Components *camera, const Components *components) {
+// Size of one raster cell in world space, at the closest point of the mesh's bounding sphere
+float getRasterCellSize(const CameraComponents *camera, const SimplifiableComponents *components) {
+    const auto &mesh = *components->renderMesh;
+    const glm::vec3 center = glm::vec3(components->transform->forward * glm::vec4(mesh.boundsCenter, 1.0f));
+    const float scale = glm::length(glm::vec3(components->transform->forward[0]));
+    const float distance = std::max(glm::length(camera->transform->getPosition() - center) - mesh.boundsRadius * scale,
+                                    camera->camera->zNear);
+
+    const float pixelSize = 2.0f * distance * std::tan(camera->camera->fovYRadians * 0.5f) /
+                            static_cast<float>(VulkanSwapchain::framebufferHeight);
+    return pixelSize * static_cast<float>(MAX_PIXELS_PER_VERTEX);
+}
+
+// The coarsest LOD whose grid cells are no larger than a raster cell, or nullptr for the full mesh
+const Importinator::Lod *selectLod(const CameraComponents *camera, const SimplifiableComponents *components) {
+    const auto &lods = components->renderMesh->lods;
+    if (lods.empty()) return nullptr;
+
+    const float scale = glm::length(glm::vec3(components->transform->forward[0]));
+    const float rasterCellSize = getRasterCellSize(camera, components);
+
+    const Importinator::Lod *selected = nullptr;
+    for (const auto &lod: lods) {
+        if (lod.cellSize * scale > rasterCellSize) break;
+        selected = &lod;
+    }
+    return selected;
+}
+
+void simplify(const CameraComponents *camera, const SimplifiableComponents *components) {
     // Init
     const auto model = components->transform->forward;
     const auto normalModel = glm::transpose(components->transform->inverse);
@@ -133,7 +192,12 @@ void simplify(const Components *camera, const Components *components) {
     const auto proj = camera->camera->getProjection(VulkanSwapchain::aspectRatio);
 
     auto &to = *components->renderMeshSimplifiable;
-    auto &from = *components->renderMesh;
+    // Starting from a precomputed LOD skips most of the work, when its cells are smaller than the raster anyway
+    const Importinator::Lod *lod = selectLod(camera, components);
+    const auto &fromVertices = lod != nullptr ? lod->vertices : components->renderMesh->vertices;
+    const auto &fromIndices = lod != nullptr ? lod->indices : components->renderMesh->indices;
+    DBG "Simplifying from " << (lod != nullptr ? "LOD with cell size " + std::to_string(lod->cellSize) : "full mesh")
+        ENDL;
     to.vertices.clear();
     to.indices.clear();
 
@@ -144,17 +208,17 @@ void simplify(const Components *camera, const Components *components) {
     DBG "Using raster " << rasterWidth << " * " << rasterHeight << " for mesh simplification" ENDL;
 
     IndexLut lut{};
-    lut.resize(from.vertices.size());
+    lut.resize(fromVertices.size());
     uint32_t newVertexCount = 0;
 
     // Calculate raster positions
 
-    for (uint32_t i = 0; i < from.vertices.size(); ++i) {
-        const glm::vec4 worldPos = model * glm::vec4(from.vertices[i].pos, 1.0f);
+    for (uint32_t i = 0; i < fromVertices.size(); ++i) {
+        const glm::vec4 worldPos = model * glm::vec4(fromVertices[i].pos, 1.0f);
 
         // Is facing away from camera
         if (glm::dot(glm::vec4(cameraPos, 1.0f) - worldPos,
-                     normalModel * glm::vec4(from.vertices[i].normal, 1.0f)) < 0) {
+                     normalModel * glm::vec4(fromVertices[i].normal, 1.0f)) < 0) {
             lut.insertMapping(i, MAX_INDEX);
             continue;
         }
@@ -196,14 +260,14 @@ void simplify(const Components *camera, const Components *components) {
 
     // Map the used vertices' indices to skip unused ones
     std::vector<bool> isVertexUsed{};
-    isVertexUsed.resize(from.vertices.size());
+    isVertexUsed.resize(fromVertices.size());
 
     // Filter triangles
     std::unordered_set<Triangle, Triangle> triangles{}; // Ordered set
-    for (uint32_t i = 0; i < from.indices.size(); i += 3) {
-        const uint32_t id1 = lut.getMapping(from.indices[i]);
-        const uint32_t id2 = lut.getMapping(from.indices[i + 1]);
-        const uint32_t id3 = lut.getMapping(from.indices[i + 2]);
+    for (uint32_t i = 0; i < fromIndices.size(); i += 3) {
+        const uint32_t id1 = lut.getMapping(fromIndices[i]);
+        const uint32_t id2 = lut.getMapping(fromIndices[i + 1]);
+        const uint32_t id3 = lut.getMapping(fromIndices[i + 2]);
 
         if (id1 == MAX_INDEX || id2 == MAX_INDEX || id3 == MAX_INDEX ||
             id1 == id2 || id1 == id3 || id2 == id3)
@@ -217,9 +281,15 @@ void simplify(const Components *camera, const Components *components) {
         triangles.insert(triangle);
     }
 
+    // Every vertex faces away or is off the raster. The renderer drops the empty result instead of uploading it.
+    if (triangles.empty()) {
+        DBG "Simplified mesh is empty" ENDL;
+        return;
+    }
+
     // Push
     std::vector<uint32_t> usedVertexIndexMappings;
-    usedVertexIndexMappings.resize(from.vertices.size());
+    usedVertexIndexMappings.resize(fromVertices.size());
 
     to.indices.reserve(triangles.size() * 3);
     to.vertices.reserve(newVertexCount);
@@ -227,13 +297,13 @@ void simplify(const Components *camera, const Components *components) {
     // Initialise the first value to enable the usedVertexIndexMappings[i] == 0 condition
     const uint32_t firstIndex = triangles.begin()->id1;
     usedVertexIndexMappings.push_back(firstIndex);
-    to.vertices.emplace_back(from.vertices[firstIndex]);
+    to.vertices.emplace_back(fromVertices[firstIndex]);
 
     for (const auto &[id1, id2, id3]: triangles) {
         if (usedVertexIndexMappings[id1] == 0) {
             usedVertexIndexMappings[id1] = to.vertices.size();
             to.indices.push_back(to.vertices.size());
-            to.vertices.push_back(from.vertices[id1]);
+            to.vertices.push_back(fromVertices[id1]);
         } else {
             to.indices.push_back(usedVertexIndexMappings[id1]);
         }
@@ -241,7 +311,7 @@ void simplify(const Components *camera, const Components *components) {
         if (usedVertexIndexMappings[id2] == 0) {
             usedVertexIndexMappings[id2] = to.vertices.size();
             to.indices.push_back(to.vertices.size());
-            to.vertices.push_back(from.vertices[id2]);
+            to.vertices.push_back(fromVertices[id2]);
         } else {
             to.indices.push_back(usedVertexIndexMappings[id2]);
         }
@@ -249,13 +319,35 @@ void simplify(const Components *camera, const Components *components) {
         if (usedVertexIndexMappings[id3] == 0) {
             usedVertexIndexMappings[id3] = to.vertices.size();
             to.indices.push_back(to.vertices.size());
-            to.vertices.push_back(from.vertices[id3]);
+            to.vertices.push_back(fromVertices[id3]);
         } else {
             to.indices.push_back(usedVertexIndexMappings[id3]);
         }
     }
 }
 
+// Replaces the simplified mesh with a fitting LOD after a large camera move. Returns true if it did.
+bool showLodAfterLargeMove(const CameraComponents *camera, const SimplifiableComponents *components) {
+    const glm::vec3 center = glm::vec3(
+            components->transform->forward * glm::vec4(components->renderMesh->boundsCenter, 1.0f));
+    const float moved = glm::length(camera->transform->getPosition() - lastSimplifiedCameraPosition);
+    if (moved <= LARGE_CAMERA_MOVE * glm::length(lastSimplifiedCameraPosition - center)) return false;
+
+    const Importinator::Lod *lod = selectLod(camera, components);
+    if (lod == nullptr) return false;
+
+    auto &to = *components->renderMeshSimplifiable;
+    if (!to.simplifiedMeshMutex.try_lock()) return false;
+    to.vertices = lod->vertices;
+    to.indices = lod->indices;
+    to.updateSimplifiedMesh = true;
+    to.markChanged();
+    to.simplifiedMeshMutex.unlock();
+
+    DBG "Large camera move, showing LOD with cell size " << lod->cellSize ENDL;
+    return true;
+}
+
 void MeshSimplifierController::update(ECS &ecs, sec *timeTaken, uint32_t *framesTaken) {
     if (thread.joinable()) {
         simplifiedMeshCalculationThreadFrameCounter++;
@@ -266,24 +358,79 @@ void MeshSimplifierController::update(ECS &ecs, sec *timeTaken, uint32_t *frames
             *framesTaken = simplifiedMeshCalculationThreadFrameCounter;
         }
     } else {
-        auto entities = ecs.requestEntities(MeshSimplifierController::EvaluatorToSimplify);
-        auto camera = ecs.requestEntities(CameraController::EvaluatorActiveCamera)[0];
+        const EntityHandle cameraEntity = ecs.getFirst(CameraController::QueryActiveCamera);
+        const CameraComponents camera{.entity = cameraEntity,
+                                      .transform = &ecs.get<Transformer4>(cameraEntity),
+                                      .camera = &ecs.get<Projector>(cameraEntity)};
+
+        // A different view changes every result, otherwise only meshes that moved or were edited need another pass
+        const bool viewChanged = camera.transform->version != lastSimplifiedCameraVersion ||
+                                 VulkanSwapchain::framebufferWidth != lastSimplifiedFramebufferWidth ||
+                                 VulkanSwapchain::framebufferHeight != lastSimplifiedFramebufferHeight;
+        const uint64_t sinceVersion = viewChanged || hasSkippedMeshes ? 0 : lastSimplifiedVersion;
+        const uint64_t version = ChangeTracking::current();
+
+        std::vector<SimplifiableComponents> entities{};
+        bool skippedMeshes = false;
+        ecs.forEachChanged<RenderMesh, Transformer4>(
+                MeshSimplifierController::QueryToSimplify, sinceVersion,
+                [&](const EntityHandle &entity, RenderMesh &mesh, Transformer4 &transform) {
+                    auto &simplifiable = ecs.get<RenderMeshSimplifiable>(entity);
+                    if (simplifiable.updateSimplifiedMesh) {
+                        skippedMeshes = true;
+                        return;
+                    }
+                    entities.push_back({.entity = entity, .renderMesh = &mesh, .transform = &transform,
+                                        .renderMeshSimplifiable = &simplifiable});
+                });
+
+        // Uploaded by the renderer this frame. The simplification starts from the new camera position next frame.
+        if (hasSimplified) {
+            bool showedLod = false;
+            for (const auto &components: entities) {
+                showedLod |= showLodAfterLargeMove(&camera, &components);
+            }
+            if (showedLod) {
+                lastSimplifiedCameraPosition = camera.transform->getPosition();
+                return;
+            }
+        }
 
         if (!entities.empty()) {
+            lastSimplifiedCameraPosition = camera.transform->getPosition();
+            hasSimplified = true;
+            lastSimplifiedVersion = version;
+            lastSimplifiedCameraVersion = camera.transform->version;
+            lastSimplifiedFramebufferWidth = VulkanSwapchain::framebufferWidth;
+            lastSimplifiedFramebufferHeight = VulkanSwapchain::framebufferHeight;
+            hasSkippedMeshes = skippedMeshes;
+
             meshCalculationDone = false;
             simplifiedMeshCalculationThreadFrameCounter = 0;
             simplifiedMeshCalculationThreadStartedTime = Timer::now();
 
-            auto function = [=](bool &done) {
-                for (auto components: entities) {
-                    if (components->renderMeshSimplifiable->simplifiedMeshMutex.try_lock()) {
+            // Removals of these entities, and of others that would move them, wait until they are unpinned
+            ecs.pin(camera.entity);
+            for (const auto &components: entities) {
+                ecs.pin(components.entity);
+            }
+
+            auto function = [=, &ecs](bool &done) {
+                for (const auto &components: entities) {
+                    if (components.renderMeshSimplifiable->simplifiedMeshMutex.try_lock()) {
                         PerformanceLogging::meshCalculationStarted();
-                        simplify(camera, components);
-                        components->renderMeshSimplifiable->updateSimplifiedMesh = true;
+                        simplify(&camera, &components);
+                        components.renderMeshSimplifiable->updateSimplifiedMesh = true;
+                        components.renderMeshSimplifiable->markChanged();
                         PerformanceLogging::meshCalculationFinished();
-                        components->renderMeshSimplifiable->simplifiedMeshMutex.unlock();
+                        components.renderMeshSimplifiable->simplifiedMeshMutex.unlock();
+                    } else {
+                        // Only read by the main thread after joining
+                        hasSkippedMeshes = true;
                     }
+                    ecs.unpin(components.entity);
                 }
+                ecs.unpin(camera.entity);
                 done = true;
             };
 
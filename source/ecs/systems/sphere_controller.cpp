@@ -9,20 +9,19 @@
 bool doSphereRotation = false;
 
 void SphereController::update(const sec &delta, ECS &ecs) {
-    auto &inputState = *ecs.requestEntities(InputController::EvaluatorInputManagerEntity)[0]->inputState;
+    auto &inputState = ecs.get<InputState>(ecs.getFirst(InputController::QueryInputManagerEntity));
 
     if (inputState.toggleRotation == IM_DOWN_EVENT) {
         doSphereRotation = !doSphereRotation;
     }
 
     if (doSphereRotation) {
-        auto spheres = ecs.requestEntities(SphereController::EvaluatorRotatingSphere);
-
-        for (auto sphere: spheres) {
-            sphere->transform->rotate(
+        ecs.forEach<Transformer4>(SphereController::QueryRotatingSphere, [&](const EntityHandle &,
+                                                                             Transformer4 &transform) {
+            transform.rotate(
                     glm::radians(15.0f * static_cast<float >(delta)),
                     glm::vec3(0, 1, 0));
-        }
+        });
     }
 }
 
@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/matrix_access.hpp>
 
 glm::mat4 Projector::getProjection(float aspectRatio) const {
     return glm::perspective(
@@ -31,4 +32,36 @@ glm::mat4 Projector::getView(const Transformer4 &eye) const {
     // DBG "eye:\tup:\t" << up.x << ", " << up.y << ", " << up.z ENDL;
 
     return glm::lookAt(position, center, up);
-}
\ No newline at end of file
+}
+
+// Gribb & Hartmann: https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+std::array<glm::vec4, 6> Projector::getFrustumPlanes(const glm::mat4 &viewProjection) {
+    const glm::vec4 x = glm::row(viewProjection, 0);
+    const glm::vec4 y = glm::row(viewProjection, 1);
+    const glm::vec4 z = glm::row(viewProjection, 2);
+    const glm::vec4 w = glm::row(viewProjection, 3);
+
+    std::array<glm::vec4, 6> planes{
+            w + x, // Left
+            w - x, // Right
+            w + y, // Bottom
+            w - y, // Top
+            z, // Near. Depth is 0..1 (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+            w - z // Far
+    };
+
+    for (auto &plane: planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return planes;
+}
+
+bool Projector::isSphereInFrustum(const std::array<glm::vec4, 6> &planes, glm::vec3 center, float radius) {
+    for (const auto &plane: planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
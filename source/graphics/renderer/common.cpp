@@ -7,13 +7,16 @@
 #include "graphics/vulkan/vulkan_swapchain.h"
 #include "graphics/vulkan/vulkan_images.h"
 #include "graphics/vulkan/vulkan_imgui.h"
+#include "graphics/vulkan/vulkan_timeline.h"
+#include "graphics/vulkan/vulkan_deletion_queue.h"
+#include "graphics/vulkan/vulkan_pipeline_cache.h"
 
 void Renderer::create(const std::string &title, GLFWwindow *window) {
     INF "Creating Renderer" ENDL;
 
     // Reset
     this->state = {};
-    VulkanBuffers::meshBufferToUse = 0;
+    this->currentFrame = 0;
 
     this->state.title = title;
     this->state.window = window;
@@ -29,30 +32,40 @@ void Renderer::initVulkan() {
     VulkanInstance::create(this->state.title);
     VulkanSwapchain::createSurface(this->state.window);
     VulkanDevices::create();
+    VulkanTimeline::create();
+    VulkanPipelineCache::create();
     VulkanSwapchain::createSwapchain();
     createDescriptorSetLayout();
     createGraphicsPipeline();
+    createCullingPipeline();
     VulkanBuffers::create();
     createDescriptorPool();
     createDescriptorSets();
+    createCullingDescriptorSet();
     createCommandPool();
     VulkanImages::createTextureImage();
     createSyncObjects();
 }
 
 void Renderer::destroyVulkan() {
-    vkDestroySemaphore(VulkanDevices::logical, this->imageAvailableSemaphore, nullptr);
-    vkDestroySemaphore(VulkanDevices::logical, this->renderFinishedSemaphore, nullptr);
-    vkDestroyFence(VulkanDevices::logical, this->inFlightFence, nullptr);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        vkDestroySemaphore(VulkanDevices::logical, this->imageAvailableSemaphores[i], nullptr);
+        vkDestroySemaphore(VulkanDevices::logical, this->renderFinishedSemaphores[i], nullptr);
+        vkDestroyFence(VulkanDevices::logical, this->inFlightFences[i], nullptr);
+    }
 
+    VulkanDeletionQueue::destroy();
     VulkanBuffers::destroy();
+    VulkanTimeline::destroy();
 
-    // VulkanBuffers::destroyCommandBuffer(this->commandPool);
+    // VulkanBuffers::destroyCommandBuffers(this->commandPool);
     vkDestroyCommandPool(VulkanDevices::logical, this->commandPool, nullptr);
     vkDestroyDescriptorPool(VulkanDevices::logical, this->descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(VulkanDevices::logical, this->descriptorSetLayout, nullptr);
     vkDestroyPipeline(VulkanDevices::logical, this->graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(VulkanDevices::logical, this->pipelineLayout, nullptr);
+    destroyCulling();
+    VulkanPipelineCache::destroy();
     VulkanSwapchain::destroySwapchain();
     VulkanDevices::destroy();
     vkDestroySurfaceKHR(VulkanInstance::instance, VulkanSwapchain::surface, nullptr);
@@ -0,0 +1,214 @@
+//
+// Created by Saman on 30.09.23.
+//
+
+#include "graphics/renderer.h"
+#include "graphics/uniform_buffer_object.h"
+#include "graphics/vulkan/vulkan_pipeline_cache.h"
+
+#ifdef EMBEDDED_SHADERS
+// Generated by the EmbedShaders CMake target
+#include "shaders/cull.comp.h"
+#endif
+
+#include <array>
+#include <algorithm>
+
+// local_size_x in cull.comp
+constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+// Minimum of maxComputeWorkGroupCount. Jobs are spread over the y dimension, one row of workgroups each.
+constexpr uint32_t MAX_WORKGROUPS = 65535;
+
+void Renderer::createCullingPipeline() {
+    // The draw count is written by the GPU, and every draw addresses its instance through firstInstance
+    const auto &features = VulkanDevices::optionalFeatures;
+    this->isGpuCulling = features.supportsDrawIndirectCount && features.supportsMultiDrawIndirect &&
+                         features.supportsDrawIndirectFirstInstance && features.supportsGraphicsQueueCompute;
+    this->state.uiState.isGpuCulling = this->isGpuCulling;
+
+    // Without multi draw indirect, every draw is recorded on its own and the limit does not apply
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &deviceProperties);
+    this->maxIndirectDraws = features.supportsMultiDrawIndirect
+                             ? std::min(VulkanBuffers::MAX_DRAWS, deviceProperties.limits.maxDrawIndirectCount)
+                             : VulkanBuffers::MAX_DRAWS;
+
+    if (!this->isGpuCulling) {
+        INF "GPU culling is not supported, culling on the CPU" ENDL;
+        return;
+    }
+
+    const auto startTime = Timer::now();
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    const std::array<VkDescriptorType, 4> types = {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, // Instances of this frame
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // Clusters of all meshes
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, // Jobs of this frame
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC // Draws of this frame
+    };
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = types[i];
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(VulkanDevices::logical, &layoutInfo, nullptr, &this->cullDescriptorSetLayout) !=
+        VK_SUCCESS) {
+        THROW("Failed to create culling descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &this->cullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(VulkanDevices::logical, &pipelineLayoutInfo, nullptr, &this->cullPipelineLayout) !=
+        VK_SUCCESS) {
+        THROW("Failed to create culling pipeline layout!");
+    }
+
+#ifdef EMBEDDED_SHADERS
+    VkShaderModule computeShaderModule = createShaderModule(CULL_COMP_SPV, sizeof(CULL_COMP_SPV));
+#else
+    auto computeShaderCode = Importinator::readFile("resources/shaders/cull.comp.spv");
+    VRB "Loaded compute shader with byte size: " << computeShaderCode.size() ENDL;
+
+    VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+#endif
+
+    VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
+    computeShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStageInfo.module = computeShaderModule;
+    computeShaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = computeShaderStageInfo;
+    pipelineInfo.layout = this->cullPipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(VulkanDevices::logical, VulkanPipelineCache::cache, 1, &pipelineInfo, nullptr,
+                                 &this->cullPipeline) != VK_SUCCESS) {
+        THROW("Failed to create culling pipeline!");
+    }
+
+    vkDestroyShaderModule(VulkanDevices::logical, computeShaderModule, nullptr);
+
+    DBG "Created culling pipeline in " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+}
+
+void Renderer::createCullingDescriptorSet() {
+    if (!this->isGpuCulling) return;
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = 3;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1; // All frames share one set, selected by dynamic offsets
+
+    if (vkCreateDescriptorPool(VulkanDevices::logical, &poolInfo, nullptr, &this->cullDescriptorPool) != VK_SUCCESS) {
+        THROW("Failed to create culling descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = this->cullDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &this->cullDescriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(VulkanDevices::logical, &allocInfo, &this->cullDescriptorSet) != VK_SUCCESS) {
+        THROW("Failed to allocate culling descriptor set!");
+    }
+
+    // Per-frame buffers show one frame's region, offset at bind time
+    const std::array<VkDescriptorBufferInfo, 4> bufferInfos = {
+            VkDescriptorBufferInfo{VulkanBuffers::instanceBuffer, 0, VulkanBuffers::instanceBufferStride},
+            VkDescriptorBufferInfo{VulkanBuffers::clusterBuffer, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{VulkanBuffers::cullJobBuffer, 0, VulkanBuffers::cullJobBufferStride},
+            VkDescriptorBufferInfo{VulkanBuffers::indirectBuffer, 0, VulkanBuffers::indirectBufferStride}
+    };
+
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = this->cullDescriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = i == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                    : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(VulkanDevices::logical, static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
+}
+
+void Renderer::destroyCulling() {
+    // Null handles are ignored, in case culling ran on the CPU
+    vkDestroyDescriptorPool(VulkanDevices::logical, this->cullDescriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(VulkanDevices::logical, this->cullDescriptorSetLayout, nullptr);
+    vkDestroyPipeline(VulkanDevices::logical, this->cullPipeline, nullptr);
+    vkDestroyPipelineLayout(VulkanDevices::logical, this->cullPipelineLayout, nullptr);
+    this->cullDescriptorPool = nullptr;
+    this->cullDescriptorSetLayout = nullptr;
+    this->cullPipeline = nullptr;
+    this->cullPipelineLayout = nullptr;
+}
+
+void Renderer::recordCulling(VkCommandBuffer buffer) {
+    // The draw count was zeroed by the CPU, so there is nothing to draw without jobs
+    if (this->cullJobCount == 0) return;
+
+    vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+
+    // Offsets are in binding order, skipping the cluster buffer, which is not per frame
+    uint32_t dynamicOffsets[] = {
+            VulkanBuffers::getInstanceBufferOffset(this->currentFrame),
+            VulkanBuffers::getCullJobOffset(this->currentFrame),
+            static_cast<uint32_t>(VulkanBuffers::getDrawCountOffset(this->currentFrame))
+    };
+    vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipelineLayout, 0, 1,
+                            &this->cullDescriptorSet, 3, dynamicOffsets);
+
+    // One thread per cluster of the job with the most clusters. Threads beyond a job's clusters exit right away.
+    const uint32_t groupCountX = (this->maxClustersPerJob + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    for (uint32_t firstJob = 0; firstJob < this->cullJobCount; firstJob += MAX_WORKGROUPS) {
+        this->cullPushConstants.firstJob = firstJob;
+        vkCmdPushConstants(buffer, this->cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(CullPushConstants), &this->cullPushConstants);
+        vkCmdDispatch(buffer, groupCountX, std::min(MAX_WORKGROUPS, this->cullJobCount - firstJob), 1);
+    }
+
+    // The draws are read as indirect commands, and the count by the CPU once this frame's fence is signalled
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr,
+                         0, nullptr);
+}
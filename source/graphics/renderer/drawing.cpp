@@ -7,12 +7,27 @@
 #include "graphics/vulkan/vulkan_renderpasses.h"
 #include "graphics/vulkan/vulkan_swapchain.h"
 #include "graphics/vulkan/vulkan_imgui.h"
+#include "graphics/vulkan/vulkan_timeline.h"
+#include "graphics/vulkan/vulkan_deletion_queue.h"
+#include "graphics/vulkan/vulkan_pipeline_cache.h"
+
+#ifdef EMBEDDED_SHADERS
+// Generated by the EmbedShaders CMake target
+#include "shaders/sphere.vert.h"
+#include "shaders/sphere.frag.h"
+#endif
 
 #include <thread>
+#include <array>
 
 
 void Renderer::createGraphicsPipeline() {
-    // TODO pull these out of here
+    const auto startTime = Timer::now();
+
+#ifdef EMBEDDED_SHADERS
+    VkShaderModule vertShaderModule = createShaderModule(SPHERE_VERT_SPV, sizeof(SPHERE_VERT_SPV));
+    VkShaderModule fragShaderModule = createShaderModule(SPHERE_FRAG_SPV, sizeof(SPHERE_FRAG_SPV));
+#else
     auto vertShaderCode = Importinator::readFile("resources/shaders/sphere.vert.spv");
     VRB "Loaded vertex shader with byte size: " << vertShaderCode.size() ENDL;
     auto fragShaderCode = Importinator::readFile("resources/shaders/sphere.frag.spv");
@@ -20,6 +35,7 @@ void Renderer::createGraphicsPipeline() {
 
     VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
     VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+#endif
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -131,8 +147,8 @@ void Renderer::createGraphicsPipeline() {
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    // Per-object matrices are in the instance buffer, so draws can come from a buffer too
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
 
     if (vkCreatePipelineLayout(VulkanDevices::logical, &pipelineLayoutInfo, nullptr, &this->pipelineLayout) !=
         VK_SUCCESS) {
@@ -172,7 +188,7 @@ void Renderer::createGraphicsPipeline() {
     pipelineInfo.basePipelineIndex = -1; // Optional
     pipelineInfo.pDepthStencilState = &depthStencil;
 
-    if (vkCreateGraphicsPipelines(VulkanDevices::logical, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+    if (vkCreateGraphicsPipelines(VulkanDevices::logical, VulkanPipelineCache::cache, 1, &pipelineInfo, nullptr,
                                   &this->graphicsPipeline) != VK_SUCCESS) {
         THROW("Failed to create graphics pipeline!");
     }
@@ -180,20 +196,42 @@ void Renderer::createGraphicsPipeline() {
     // Once the pipeline is created, we don't need this anymore
     vkDestroyShaderModule(VulkanDevices::logical, fragShaderModule, nullptr);
     vkDestroyShaderModule(VulkanDevices::logical, vertShaderModule, nullptr);
+
+    DBG "Created graphics pipeline in " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+}
+
+void Renderer::recreatePipelines() {
+    // Frames in flight may still draw with the old pipeline
+    VulkanDeletionQueue::enqueue([pipeline = this->graphicsPipeline, layout = this->pipelineLayout]() {
+        vkDestroyPipeline(VulkanDevices::logical, pipeline, nullptr);
+        vkDestroyPipelineLayout(VulkanDevices::logical, layout, nullptr);
+    });
+    createGraphicsPipeline();
+
+    VulkanImgui::recreateRenderer();
 }
 
 void Renderer::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC; // Offset into the ring per frame
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // Can also be all shader stages: VK_SHADER_STAGE_ALL_GRAPHICS
     uboLayoutBinding.pImmutableSamplers = nullptr; // Relevant for image sampling
 
+    VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+    instanceLayoutBinding.binding = 1;
+    instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC; // Indexed by gl_InstanceIndex
+    instanceLayoutBinding.descriptorCount = 1;
+    instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, instanceLayoutBinding};
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
     if (vkCreateDescriptorSetLayout(VulkanDevices::logical, &layoutInfo, nullptr, &this->descriptorSetLayout) !=
         VK_SUCCESS) {
@@ -203,15 +241,17 @@ void Renderer::createDescriptorSetLayout() {
 
 void Renderer::createDescriptorPool() {
     // Can have multiple pools, with multiple buffers each
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(VulkanBuffers::UBO_BUFFER_COUNT);
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = 1;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(VulkanBuffers::UBO_BUFFER_COUNT);
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1; // All frames share one set, selected by dynamic offset
     // poolInfo.flags = 0; // Investigate VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
     // Would mean that Descriptor sets could individually be freed to their pools
     // Would allow vkFreeDescriptorSets
@@ -223,40 +263,50 @@ void Renderer::createDescriptorPool() {
 }
 
 void Renderer::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(VulkanBuffers::UBO_BUFFER_COUNT, this->descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = this->descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(VulkanBuffers::UBO_BUFFER_COUNT);
-    allocInfo.pSetLayouts = layouts.data();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &this->descriptorSetLayout;
 
-    this->descriptorSets.resize(VulkanBuffers::UBO_BUFFER_COUNT);
-    if (vkAllocateDescriptorSets(VulkanDevices::logical, &allocInfo, this->descriptorSets.data()) != VK_SUCCESS) {
+    if (vkAllocateDescriptorSets(VulkanDevices::logical, &allocInfo, &this->descriptorSet) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate descriptor sets!");
     }
 
-    for (size_t i = 0; i < VulkanBuffers::UBO_BUFFER_COUNT; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = VulkanBuffers::uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject); // Or VK_WHOLE_SIZE
-
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = this->descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0; // Descriptors can be arrays! -> index 0 here
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1; // starting at .dstArrayElement
-
-        // Specify one of these three, depending on the type of descriptor this is
-        descriptorWrite.pBufferInfo = &bufferInfo;
-        descriptorWrite.pImageInfo = nullptr; // Optional
-        descriptorWrite.pTexelBufferView = nullptr; // Optional
-
-        // Optional VkCopyDescriptorSet to copy between descriptors
-        vkUpdateDescriptorSets(VulkanDevices::logical, 1, &descriptorWrite, 0, nullptr);
-    }
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = VulkanBuffers::uniformBuffer;
+    bufferInfo.offset = 0; // The frame's slot is added as dynamic offset at bind time
+    bufferInfo.range = sizeof(UniformBufferObject); // The visible window, not the whole ring
+
+    VkDescriptorBufferInfo instanceBufferInfo{};
+    instanceBufferInfo.buffer = VulkanBuffers::instanceBuffer;
+    instanceBufferInfo.offset = 0;
+    instanceBufferInfo.range = VulkanBuffers::instanceBufferStride;
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = this->descriptorSet;
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0; // Descriptors can be arrays! -> index 0 here
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[0].descriptorCount = 1; // starting at .dstArrayElement
+
+    // Specify one of these three, depending on the type of descriptor this is
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+    descriptorWrites[0].pImageInfo = nullptr; // Optional
+    descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = this->descriptorSet;
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pBufferInfo = &instanceBufferInfo;
+
+    // Optional VkCopyDescriptorSet to copy between descriptors
+    vkUpdateDescriptorSets(VulkanDevices::logical, static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(), 0, nullptr);
 }
 
 void Renderer::createCommandPool() {
@@ -272,7 +322,7 @@ void Renderer::createCommandPool() {
 
     this->state.vulkanState.commandPool = this->commandPool;
 
-    VulkanBuffers::createCommandBuffer(this->commandPool);
+    VulkanBuffers::createCommandBuffers(this->commandPool);
 }
 
 void Renderer::createSyncObjects() {
@@ -283,16 +333,22 @@ void Renderer::createSyncObjects() {
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Start off as signaled
 
-    if (vkCreateSemaphore(VulkanDevices::logical, &semaphoreInfo, nullptr, &this->imageAvailableSemaphore) !=
-        VK_SUCCESS ||
-        vkCreateSemaphore(VulkanDevices::logical, &semaphoreInfo, nullptr, &this->renderFinishedSemaphore) !=
-        VK_SUCCESS ||
-        vkCreateFence(VulkanDevices::logical, &fenceInfo, nullptr, &this->inFlightFence) != VK_SUCCESS) {
-        THROW("Failed to create semaphores and/or fences!");
+    this->imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    this->renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    this->inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (vkCreateSemaphore(VulkanDevices::logical, &semaphoreInfo, nullptr, &this->imageAvailableSemaphores[i]) !=
+            VK_SUCCESS ||
+            vkCreateSemaphore(VulkanDevices::logical, &semaphoreInfo, nullptr, &this->renderFinishedSemaphores[i]) !=
+            VK_SUCCESS ||
+            vkCreateFence(VulkanDevices::logical, &fenceInfo, nullptr, &this->inFlightFences[i]) != VK_SUCCESS) {
+            THROW("Failed to create semaphores and/or fences!");
+        }
     }
 }
 
-void Renderer::recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex) {
+void Renderer::recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex, ECS &ecs) {
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = 0; // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkCommandBufferUsageFlagBits.html
@@ -302,6 +358,10 @@ void Renderer::recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex)
         THROW("Failed to begin recording command buffer!");
     }
 
+    if (this->isGpuCulling) {
+        recordCulling(buffer);
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = VulkanRenderPasses::renderPass;
@@ -321,13 +381,6 @@ void Renderer::recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex)
 
     vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
 
-    VkBuffer vertexBuffers[] = {VulkanBuffers::vertexBuffer[VulkanBuffers::meshBufferToUse]};
-    VkDeviceSize offsets[] = {0};
-    // Offset and number of bindings, buffers, and byte offsets from those buffers
-    vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(buffer, VulkanBuffers::indexBuffer[VulkanBuffers::meshBufferToUse], 0, VK_INDEX_TYPE_UINT32);
-
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -342,17 +395,40 @@ void Renderer::recordCommandBuffer(VkCommandBuffer buffer, uint32_t imageIndex)
     scissor.extent = VulkanSwapchain::extent;
     vkCmdSetScissor(buffer, 0, 1, &scissor);
 
-    // TODO Do not directly access uniform buffer index like this
+    // View, projection and instance transforms are bound once per frame. Offsets are in binding order.
+    uint32_t dynamicOffsets[] = {VulkanBuffers::getUniformBufferOffset(this->currentFrame),
+                                 VulkanBuffers::getInstanceBufferOffset(this->currentFrame)};
     vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1,
-                            &this->descriptorSets[VulkanBuffers::uniformBufferIndex], 0, nullptr);
+                            &this->descriptorSet, 2, dynamicOffsets);
 
-#ifdef INSTANCED_RENDERING
-    vkCmdDrawIndexed(buffer, VulkanBuffers::indexCount[VulkanBuffers::meshBufferToUse], 25, 0, 0, 0);
-#else
-    vkCmdDrawIndexed(buffer, VulkanBuffers::indexCount[VulkanBuffers::meshBufferToUse], 1, 0, 0, 0);
-#endif
+    // All meshes share one vertex and one index buffer
+    VkBuffer vertexBuffers[] = {VulkanBuffers::vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    // Offset and number of bindings, buffers, and byte offsets from those buffers
+    vkCmdBindVertexBuffers(buffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(buffer, VulkanBuffers::indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    // Draws come from this frame's region of the indirect buffer, written by recordCulling or updateDrawBuffers
+    const VkDeviceSize drawOffset = VulkanBuffers::getDrawCommandOffset(this->currentFrame);
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    const auto &features = VulkanDevices::optionalFeatures;
+    if (this->isGpuCulling) {
+        // Only the GPU knows how many draws there are
+        vkCmdDrawIndexedIndirectCount(buffer, VulkanBuffers::indirectBuffer, drawOffset, VulkanBuffers::indirectBuffer,
+                                      VulkanBuffers::getDrawCountOffset(this->currentFrame), this->maxIndirectDraws,
+                                      stride);
+    } else if (features.supportsMultiDrawIndirect && features.supportsDrawIndirectFirstInstance) {
+        vkCmdDrawIndexedIndirect(buffer, VulkanBuffers::indirectBuffer, drawOffset, this->drawCount, stride);
+    } else {
+        // The CPU wrote the commands, so it can issue them directly. Direct draws may start at any instance.
+        const VkDrawIndexedIndirectCommand *draws = VulkanBuffers::getDrawCommandMapping(this->currentFrame);
+        for (uint32_t draw = 0; draw < this->drawCount; ++draw) {
+            vkCmdDrawIndexed(buffer, draws[draw].indexCount, draws[draw].instanceCount, draws[draw].firstIndex,
+                             draws[draw].vertexOffset, draws[draw].firstInstance);
+        }
+    }
 
-    this->drawUi();
+    this->drawUi(buffer);
 
     vkCmdEndRenderPass(buffer);
 
@@ -373,20 +449,29 @@ sec Renderer::draw(const sec &delta, ECS &ecs) {
             return -1;
         }
     }
+    if (VulkanSwapchain::hasNewRenderPass) {
+        recreatePipelines();
+        VulkanSwapchain::hasNewRenderPass = false;
+    }
+    VulkanSwapchain::collectRetiredResources();
+    VulkanDeletionQueue::collect();
 
     uploadRenderables(ecs);
     uploadSimplifiedMeshes(ecs);
     destroyRenderables(ecs);
 
+    // Only waits for the GPU to finish the frame that last used this slot, MAX_FRAMES_IN_FLIGHT frames ago
+    auto inFlightFence = this->inFlightFences[this->currentFrame];
     auto beforeFence = Timer::now();
-    vkWaitForFences(VulkanDevices::logical, 1, &this->inFlightFence, VK_TRUE, UINT64_MAX);
+    vkWaitForFences(VulkanDevices::logical, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
     auto afterFence = Timer::now();
 
 //    printf("Waited for fence: %f seconds\n", Timer::duration(beforeFence, afterFence));
 
     uint32_t imageIndex;
     auto acquireImageResult = vkAcquireNextImageKHR(VulkanDevices::logical, VulkanSwapchain::swapchain, UINT64_MAX,
-                                                    this->imageAvailableSemaphore, nullptr, &imageIndex);
+                                                    this->imageAvailableSemaphores[this->currentFrame], nullptr,
+                                                    &imageIndex);
 
     if (acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
         DBG "Swapchain is out of date" ENDL;
@@ -401,34 +486,59 @@ sec Renderer::draw(const sec &delta, ECS &ecs) {
     }
 
     // Avoid deadlock if recreating -> move to after success check
-    vkResetFences(VulkanDevices::logical, 1, &this->inFlightFence);
+    vkResetFences(VulkanDevices::logical, 1, &inFlightFence);
 
-    auto commandBuffer = VulkanBuffers::commandBuffer;
+    auto commandBuffer = VulkanBuffers::commandBuffers[this->currentFrame];
 
     updateUniformBuffer(delta, ecs);
+    if (this->isGpuCulling) {
+        updateCullJobs(ecs);
+    } else {
+        updateDrawBuffers(ecs);
+    }
 
     vkResetCommandBuffer(commandBuffer, 0); // I am not convinced this is necessary
-    recordCommandBuffer(commandBuffer, imageIndex);
+    recordCommandBuffer(commandBuffer, imageIndex, ecs);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {this->imageAvailableSemaphore}; // index corresponding to wait stage
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}; // Wait in fragment stage
+    // Binary semaphores ignore their entry in the timeline value arrays
+    VkSemaphore waitSemaphores[] = {this->imageAvailableSemaphores[this->currentFrame],
+                                    VulkanTimeline::upload.semaphore};
+    // Already reached, so this never stalls. It makes the uploaded meshes visible to this queue.
+    uint64_t waitValues[] = {0, this->drawnUploadValue};
+    VkPipelineStageFlags waitStages[] = {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // Wait in fragment stage
+            // The mesh has to be uploaded before its clusters are culled and its vertices are read
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+    };
     // or VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = 2;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkSemaphore signalSemaphores[] = {this->renderFinishedSemaphore};
-    submitInfo.signalSemaphoreCount = 1;
+    const uint64_t renderValue = VulkanTimeline::render.next();
+
+    VkSemaphore renderFinishedSemaphore = this->renderFinishedSemaphores[this->currentFrame];
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphore, VulkanTimeline::render.semaphore};
+    uint64_t signalValues[] = {0, renderValue};
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 2;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    submitInfo.pNext = &timelineInfo;
+
 //    START_TRACE
-    if (vkQueueSubmit(VulkanDevices::graphicsQueue, 1, &submitInfo, this->inFlightFence) != VK_SUCCESS) {
+    if (vkQueueSubmit(VulkanDevices::graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
         THROW("Failed to submit draw command buffer!");
     }
 //    END_TRACE("QUEUE SUBMIT")
@@ -437,7 +547,7 @@ sec Renderer::draw(const sec &delta, ECS &ecs) {
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
 
     VkSwapchainKHR swapchains[] = {VulkanSwapchain::swapchain};
     presentInfo.swapchainCount = 1;
@@ -446,6 +556,9 @@ sec Renderer::draw(const sec &delta, ECS &ecs) {
     presentInfo.pResults = nullptr; // Per swapchain acquireImageResult
 
     vkQueuePresentKHR(VulkanDevices::presentQueue, &presentInfo);
+    VulkanSwapchain::onImagePresented(imageIndex, renderValue);
+
+    this->currentFrame = (this->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
     return Timer::duration(beforeFence, afterFence);
 }
@@ -5,11 +5,15 @@
 #include "graphics/renderer.h"
 
 VkShaderModule Renderer::createShaderModule(const std::vector<char> &code) {
+    // Cast the pointer. Vectors already handle proper memory alignment.
+    return createShaderModule(reinterpret_cast<const uint32_t *>(code.data()), code.size());
+}
+
+VkShaderModule Renderer::createShaderModule(const uint32_t *code, size_t byteSize) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    // Cast the pointer. Vectors already handle proper memory alignment.
-    createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    createInfo.codeSize = byteSize;
+    createInfo.pCode = code;
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(VulkanDevices::logical, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -5,54 +5,84 @@
 #include "graphics/renderer.h"
 #include "graphics/uniform_buffer_object.h"
 #include "graphics/vulkan/vulkan_swapchain.h"
+#include "graphics/vulkan/vulkan_timeline.h"
 #include "util/performance_logging.h"
 
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
 // SYSTEMS THAT PLUG INTO THE ECS
 
 void Renderer::uploadRenderables(ECS &ecs) {
-    auto entities = ecs.requestEntities(Renderer::EvaluatorToAllocate);
-    for (auto components: entities) {
-        auto &mesh = *components->renderMesh;
-        VulkanBuffers::uploadVertices(mesh.vertices);
-        VulkanBuffers::uploadIndices(mesh.indices);
-        mesh.isAllocated = true;
-    }
+    VulkanBuffers::reclaimFinishedUploads();
+    ecs.forEach<RenderMesh>(Renderer::QueryMeshes, [&](const EntityHandle &, RenderMesh &mesh) {
+        // Retried next frame
+        if (mesh.allocation.isValid() || mesh.vertices.empty() || mesh.isTooLarge || !VulkanBuffers::canUpload()) {
+            return;
+        }
+        if (!VulkanBuffers::canEverFitMesh(mesh.vertices.size(), mesh.indices.size())) {
+            INF "Mesh with " << mesh.vertices.size() << " vertices and " << mesh.indices.size()
+                << " indices does not fit the mesh buffers, it will not be drawn" ENDL;
+            mesh.isTooLarge = true;
+            return;
+        }
+
+        // Asynchronous, so adding meshes at runtime does not stall. The mesh is drawn once the upload finished.
+        mesh.allocation = VulkanBuffers::uploadMesh(mesh.vertices, mesh.indices);
+    });
 }
 
 void Renderer::uploadSimplifiedMeshes(ECS &ecs) {
-    if (VulkanBuffers::waitingForFence) {
-        DBG "Waiting for fence" ENDL;
-        if (VulkanBuffers::isTransferQueueReady()) {
-            DBG "Ready" ENDL;
-            VulkanBuffers::finishTransfer();
-        } else {
-            DBG "Not ready" ENDL;
-            return;
-        }
+    VulkanBuffers::reclaimFinishedUploads();
+    const uint64_t uploaded = VulkanTimeline::completedValue(VulkanTimeline::upload);
+
+    // Every mesh swaps to its new version once it arrived, and keeps drawing the previous one until then
+    ecs.forEach<RenderMeshSimplifiable>(Renderer::QuerySimplifiedMeshes, [&](const EntityHandle &,
+                                                                            RenderMeshSimplifiable &mesh) {
+        if (!mesh.pendingAllocation.isValid() || mesh.pendingAllocation.uploadValue > uploaded) return;
+        VulkanBuffers::releaseMesh(mesh.allocation);
+        mesh.allocation = mesh.pendingAllocation;
+        mesh.pendingAllocation = {};
+        mesh.isEmpty = false;
+    });
+
+    if (!VulkanBuffers::canUpload()) {
+        DBG "All upload command buffers are in flight" ENDL;
+        return;
     }
     const auto startTime = Timer::now();
-    auto entities = ecs.requestEntities(Renderer::EvaluatorToAllocateSimplifiedMesh);
-
-    uint32_t bufferToUse = 1;
-    if (VulkanBuffers::meshBufferToUse == 1) bufferToUse = 2;
 
     bool uploadedAny = false;
 
-    for (auto components: entities) {
-        if (components->renderMeshSimplifiable->simplifiedMeshMutex.try_lock()) {
+    ecs.forEach<RenderMeshSimplifiable>(Renderer::QuerySimplifiedMeshes, [&](const EntityHandle &,
+                                                                            RenderMeshSimplifiable &mesh) {
+        if (!mesh.updateSimplifiedMesh || !VulkanBuffers::canUpload()) return;
+
+        if (mesh.simplifiedMeshMutex.try_lock()) {
+            if (mesh.indices.empty()) {
+                // Nothing of the mesh is visible. There is nothing to upload, and nothing to draw until that changes.
+                VulkanBuffers::releaseMesh(mesh.pendingAllocation);
+                VulkanBuffers::releaseMesh(mesh.allocation);
+                mesh.isEmpty = true;
+                mesh.updateSimplifiedMesh = false;
+                mesh.simplifiedMeshMutex.unlock();
+                return;
+            }
+
             PerformanceLogging::meshUploadStarted();
-            auto &mesh = *components->renderMeshSimplifiable;
-            // TODO this upload produced a bad access error
-            VulkanBuffers::uploadMesh(mesh.vertices, mesh.indices, true, bufferToUse);
-            mesh.isAllocated = true;
-            mesh.bufferIndex = bufferToUse;
-            mesh.updateSimplifiedMesh = false;
-            PerformanceLogging::meshUploadFinished({mesh.vertices.size(), mesh.indices.size() / 3});
+            auto allocation = VulkanBuffers::uploadMesh(mesh.vertices, mesh.indices);
+            if (allocation.isValid()) {
+                // A newer version replaces one that is still uploading
+                VulkanBuffers::releaseMesh(mesh.pendingAllocation);
+                mesh.pendingAllocation = allocation;
+                mesh.updateSimplifiedMesh = false;
+                PerformanceLogging::meshUploadFinished({mesh.vertices.size(), mesh.indices.size() / 3});
+                uploadedAny = true;
+            }
             mesh.simplifiedMeshMutex.unlock();
-
-            uploadedAny = true;
         }
-    }
+    });
 
     if (uploadedAny) {
         // Treat this like a return
@@ -61,30 +91,229 @@ void Renderer::uploadSimplifiedMeshes(ECS &ecs) {
 }
 
 void Renderer::destroyRenderables(ECS &ecs) {
-    auto entities = ecs.requestEntities(Renderer::EvaluatorToDeallocate);
-    for (auto components: entities) {
-        auto &mesh = *components->renderMesh;
-        THROW("TODO");
+    // Removed entities may still be pinned, and reported again next frame. Releasing invalidates, so that is fine.
+    ecs.forEachRemoved<RenderMesh>([&](const EntityHandle &entity, RenderMesh &mesh) {
+        VulkanBuffers::releaseMesh(mesh.allocation);
+        if (auto simplifiable = ecs.tryGet<RenderMeshSimplifiable>(entity)) {
+            VulkanBuffers::releaseMesh(simplifiable->allocation);
+            VulkanBuffers::releaseMesh(simplifiable->pendingAllocation);
+        }
+    });
+}
+
+const MeshAllocation *Renderer::getDrawnAllocation(ECS &ecs, const EntityHandle &entity, const RenderMesh &mesh,
+                                                   uint64_t uploadedValue) {
+    // Meshes that are being simplified show their latest simplified version
+    const MeshAllocation *allocation = &mesh.allocation;
+    if (auto simplifiable = ecs.tryGet<RenderMeshSimplifiable>(entity)) {
+        if (simplifiable->isEmpty) return nullptr;
+        if (simplifiable->allocation.isValid()) allocation = &simplifiable->allocation;
     }
+
+    if (!allocation->isValid() || allocation->uploadValue > uploadedValue) return nullptr;
+    return allocation;
 }
 
 void Renderer::updateUniformBuffer(const sec &delta, ECS &ecs) {
-    auto entities = ecs.requestEntities(Renderer::EvaluatorToDraw);
-
-    auto &sphere = *entities[0];
-    // TODO not just for one object
+    // Model matrices are written per instance in updateDrawBuffers
     UniformBufferObject ubo{};
-    ubo.model = sphere.transform->forward;
 
-    auto &camera = *ecs.requestEntities(Renderer::EvaluatorActiveCamera)[0];
+    const EntityHandle camera = ecs.getFirst(Renderer::QueryActiveCamera);
 
-    ubo.view = camera.camera->getView(*camera.transform);
+    // Every frame in flight has its own slot, which keeps its contents until the camera or the window changes
+    auto &written = this->uniformBufferStates[this->currentFrame];
+    const uint64_t cameraVersion = ecs.get<Transformer4>(camera).version;
+    if (written.cameraVersion == cameraVersion && written.aspectRatio == VulkanSwapchain::aspectRatio) {
+        return;
+    }
+    written = {.cameraVersion = cameraVersion, .aspectRatio = VulkanSwapchain::aspectRatio};
+
+    ubo.view = ecs.get<Projector>(camera).getView(ecs.get<Transformer4>(camera));
 
-    ubo.proj = camera.camera->getProjection(VulkanSwapchain::aspectRatio);
+    ubo.proj = ecs.get<Projector>(camera).getProjection(VulkanSwapchain::aspectRatio);
+
+    memcpy(VulkanBuffers::getUniformBufferMapping(this->currentFrame), &ubo, sizeof(ubo));
+}
 
-    // TODO replace with push constants for small objects:
-    // https://registry.khronos.org/vulkan/site/guide/latest/push_constants.html
+bool isMeshVisible(const std::array<glm::vec4, 6> &frustum, const RenderMesh &mesh, const glm::mat4 &model) {
+    glm::vec3 center = model * glm::vec4(mesh.boundsCenter, 1.0f);
+    // Scaling grows the sphere by the longest axis
+    float scaleSquared = std::max({glm::dot(model[0], model[0]),
+                                   glm::dot(model[1], model[1]),
+                                   glm::dot(model[2], model[2])});
+    return Projector::isSphereInFrustum(frustum, center, mesh.boundsRadius * std::sqrt(scaleSquared));
+}
+
+InstanceData toInstanceData(const glm::mat4 &model) {
+    // Transformer4::inverse is not the true inverse after combined transformations, so invert the upper 3x3 here
+    return {.model = model, .normal = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))))};
+}
 
-    VulkanBuffers::nextUniformBuffer();
-    memcpy(VulkanBuffers::getCurrentUniformBufferMapping(), &ubo, sizeof(ubo));
-}
\ No newline at end of file
+void Renderer::updateDrawBuffers(ECS &ecs) {
+    const EntityHandle cameraEntity = ecs.getFirst(Renderer::QueryActiveCamera);
+    const auto &camera = ecs.get<Projector>(cameraEntity);
+    const auto frustum = Projector::getFrustumPlanes(
+            camera.getProjection(VulkanSwapchain::aspectRatio) * camera.getView(ecs.get<Transformer4>(cameraEntity)));
+
+    // Group instances by the index of the mesh they place
+    std::unordered_map<uint32_t, std::vector<const Transformer4 *>> instancesByParent{};
+    ecs.forEach<MeshInstance, Transformer4>(Renderer::QueryInstances, [&](const EntityHandle &, MeshInstance &instance,
+                                                                        Transformer4 &transform) {
+        if (!ecs.isAlive(instance.parent)) return;
+        instancesByParent[instance.parent.index].push_back(&transform);
+    });
+
+    InstanceData *instances = VulkanBuffers::getInstanceBufferMapping(this->currentFrame);
+    VkDrawIndexedIndirectCommand *draws = VulkanBuffers::getDrawCommandMapping(this->currentFrame);
+    uint32_t instanceCount = 0;
+    uint32_t drawCount = 0;
+    uint32_t culledCount = 0;
+    uint32_t drawnVertices = 0, drawnTriangles = 0;
+
+    this->drawnUploadValue = VulkanTimeline::completedValue(VulkanTimeline::upload);
+
+    ecs.forEach<RenderMesh, Transformer4>(Renderer::QueryToDraw, [&](const EntityHandle &entity, RenderMesh &mesh,
+                                                                    Transformer4 &transform) {
+        const MeshAllocation *allocation = getDrawnAllocation(ecs, entity, mesh, this->drawnUploadValue);
+        if (allocation == nullptr) return;
+        if (drawCount >= this->maxIndirectDraws) {
+            DBG "Indirect draw buffer is full" ENDL;
+            return;
+        }
+        const auto &model = transform.forward;
+
+        // Every visible instance gets its own world matrix, so one draw covers all instances of a mesh
+        const uint32_t firstInstance = instanceCount;
+        auto addInstance = [&](const glm::mat4 &world) {
+            if (instanceCount >= VulkanBuffers::MAX_INSTANCES) {
+                DBG "Instance buffer is full" ENDL;
+                return;
+            }
+            if (!isMeshVisible(frustum, mesh, world)) {
+                ++culledCount;
+                return;
+            }
+            instances[instanceCount++] = toInstanceData(world);
+        };
+
+        auto found = instancesByParent.find(entity.index);
+        if (found == instancesByParent.end()) {
+            addInstance(model);
+        } else {
+            for (auto instance: found->second) {
+                addInstance(instance->forward * model);
+            }
+        }
+        if (instanceCount == firstInstance) return; // Culled
+
+        // Indices are relative to the mesh's first vertex.
+        // gl_InstanceIndex starts at firstInstance, so every draw reads its own slice of the instance buffer.
+        draws[drawCount++] = {
+                .indexCount = allocation->indexCount,
+                .instanceCount = instanceCount - firstInstance,
+                .firstIndex = allocation->firstIndex,
+                .vertexOffset = static_cast<int32_t>(allocation->firstVertex),
+                .firstInstance = firstInstance
+        };
+        drawnVertices += allocation->vertexCount;
+        drawnTriangles += allocation->indexCount / 3;
+    });
+
+    *VulkanBuffers::getDrawCountMapping(this->currentFrame) = drawCount;
+    this->drawCount = drawCount;
+
+    this->state.uiState.instancesDrawn = instanceCount;
+    this->state.uiState.instancesCulled = culledCount;
+    this->state.uiState.currentMeshVertices = drawnVertices;
+    this->state.uiState.currentMeshTriangles = drawnTriangles;
+}
+
+void Renderer::updateCullJobs(ECS &ecs) {
+    const EntityHandle cameraEntity = ecs.getFirst(Renderer::QueryActiveCamera);
+    const auto &camera = ecs.get<Projector>(cameraEntity);
+    const auto &cameraTransform = ecs.get<Transformer4>(cameraEntity);
+    const auto frustum = Projector::getFrustumPlanes(
+            camera.getProjection(VulkanSwapchain::aspectRatio) * camera.getView(cameraTransform));
+
+    // Group instances by the index of the mesh they place
+    std::unordered_map<uint32_t, std::vector<const Transformer4 *>> instancesByParent{};
+    ecs.forEach<MeshInstance, Transformer4>(Renderer::QueryInstances, [&](const EntityHandle &, MeshInstance &instance,
+                                                                        Transformer4 &transform) {
+        if (!ecs.isAlive(instance.parent)) return;
+        instancesByParent[instance.parent.index].push_back(&transform);
+    });
+
+    // What cull.comp left when this frame slot was last drawn. Its fence has been waited for.
+    // cull.comp counts the draws it had to drop as well.
+    uint32_t *gpuDrawCount = VulkanBuffers::getDrawCountMapping(this->currentFrame);
+    this->state.uiState.gpuDraws = std::min(*gpuDrawCount, this->maxIndirectDraws);
+    if (*gpuDrawCount > this->maxIndirectDraws && !this->isCullingWholeMeshes) {
+        INF "Culled clusters need " << *gpuDrawCount << " draws, but only " << this->maxIndirectDraws
+            << " fit. Culling whole meshes from now on." ENDL;
+        this->isCullingWholeMeshes = true;
+    }
+    *gpuDrawCount = 0;
+
+    InstanceData *instances = VulkanBuffers::getInstanceBufferMapping(this->currentFrame);
+    CullJob *jobs = VulkanBuffers::getCullJobMapping(this->currentFrame);
+    uint32_t jobCount = 0;
+    uint32_t maxClusters = 0;
+    uint32_t drawnVertices = 0, drawnTriangles = 0;
+
+    this->drawnUploadValue = VulkanTimeline::completedValue(VulkanTimeline::upload);
+
+    ecs.forEach<RenderMesh, Transformer4>(Renderer::QueryToDraw, [&](const EntityHandle &entity, RenderMesh &mesh,
+                                                                    Transformer4 &transform) {
+        const MeshAllocation *allocation = getDrawnAllocation(ecs, entity, mesh, this->drawnUploadValue);
+        if (allocation == nullptr) return;
+        const auto &model = transform.forward;
+        auto found = instancesByParent.find(entity.index);
+        const bool isInstanced = found != instancesByParent.end();
+        const bool isWhole = isInstanced || this->isCullingWholeMeshes;
+
+        // Instanced meshes are only culled as a whole. Splitting every instance into clusters multiplies the draws.
+        // Same for all meshes once the clusters did not fit into the draw buffer.
+        CullJob job{
+                .boundsCluster = allocation->firstCluster,
+                .firstCluster = isWhole ? allocation->firstCluster : allocation->firstCluster + 1,
+                .clusterCount = isWhole ? 1 : allocation->clusterCount - 1,
+                .vertexOffset = static_cast<int32_t>(allocation->firstVertex)
+        };
+        // Instance and job share their index
+        auto addJob = [&](const glm::mat4 &world) {
+            if (jobCount >= VulkanBuffers::MAX_INSTANCES) {
+                DBG "Cull job buffer is full" ENDL;
+                return;
+            }
+            instances[jobCount] = toInstanceData(world);
+            job.instance = jobCount;
+            jobs[jobCount++] = job;
+        };
+
+        if (isInstanced) {
+            for (auto instance: found->second) {
+                addJob(instance->forward * model);
+            }
+        } else {
+            addJob(model);
+        }
+        maxClusters = std::max(maxClusters, job.clusterCount);
+        drawnVertices += allocation->vertexCount;
+        drawnTriangles += allocation->indexCount / 3;
+    });
+
+    this->cullJobCount = jobCount;
+    this->maxClustersPerJob = maxClusters;
+    this->cullPushConstants = {
+            .cameraPosition = glm::vec4(cameraTransform.getPosition(), 1.0f),
+            .firstJob = 0, // Set per dispatch
+            .jobCount = jobCount,
+            .maxDraws = this->maxIndirectDraws
+    };
+    std::copy(frustum.begin(), frustum.end(), this->cullPushConstants.frustum);
+
+    this->state.uiState.instancesDrawn = jobCount;
+    this->state.uiState.instancesCulled = 0; // Only known to the GPU
+    this->state.uiState.currentMeshVertices = drawnVertices;
+    this->state.uiState.currentMeshTriangles = drawnTriangles;
+}
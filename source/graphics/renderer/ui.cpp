@@ -10,12 +10,14 @@ UiState *Renderer::getUiState() {
     return &this->state.uiState;
 }
 
-void Renderer::resetMesh() {
-    VulkanBuffers::resetMeshBufferToUse();
+void Renderer::resetMesh(ECS &ecs) {
+    ecs.forEach<RenderMeshSimplifiable>(Renderer::QuerySimplifiedMeshes, [&](const EntityHandle &,
+                                                                            RenderMeshSimplifiable &mesh) {
+        VulkanBuffers::releaseMesh(mesh.allocation);
+        mesh.isEmpty = false;
+    });
 }
 
-void Renderer::drawUi(){
-    this->state.uiState.currentMeshVertices = VulkanBuffers::vertexCount[VulkanBuffers::meshBufferToUse];
-    this->state.uiState.currentMeshTriangles = VulkanBuffers::indexCount[VulkanBuffers::meshBufferToUse] / 3;
-    VulkanImgui::draw(this->state);
+void Renderer::drawUi(VkCommandBuffer buffer) {
+    VulkanImgui::draw(this->state, buffer);
 }
\ No newline at end of file
@@ -26,6 +26,8 @@ void UI::update(UiState &state) {
         ImGui::Text("Total frame time: >1 second");
     }
     ImGui::Text("Frames per second: %d", state.fps.currentFPS());
+    ImGui::Text("Time to first frame: %1.4f seconds", state.timeToFirstFrame);
+    ImGui::Text("Time to interactive: %1.4f seconds", state.timeToInteractive);
 
     if (!state.loggingStarted) {
         if (ImGui::Button("Start performance log")) {
@@ -41,11 +43,17 @@ void UI::update(UiState &state) {
 
     ImGui::Text("Current vertex count: %d", state.currentMeshVertices);
     ImGui::Text("Current triangle count: %d", state.currentMeshTriangles);
+    if (state.isGpuCulling) {
+        ImGui::Text("Instances: %d, draws after GPU culling: %d", state.instancesDrawn, state.gpuDraws);
+    } else {
+        ImGui::Text("Instances drawn: %d, culled: %d", state.instancesDrawn, state.instancesCulled);
+    }
     if (ImGui::Button("Use original mesh"))
         state.returnToOriginalMeshBuffer = true;
     const std::string meshSwitchText = state.isMonkeyMesh ? "Switch to Sphere" : "Switch to Monkey";
     if (ImGui::Button(meshSwitchText.c_str()))
         state.switchMesh = true;
+    ImGui::Text("Switch took: %3.4f seconds", state.meshSwitchTimeTaken);
 
     ImGui::SeparatorText("Mesh Optimizer");
 
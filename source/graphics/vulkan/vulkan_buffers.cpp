@@ -7,40 +7,75 @@
 #include "graphics/uniform_buffer_object.h"
 #include "graphics/vulkan/vulkan_memory.h"
 #include "graphics/vulkan/vulkan_devices.h"
+#include "graphics/vulkan/vulkan_timeline.h"
+#include "graphics/vulkan/vulkan_swapchain.h"
+#include "graphics/vulkan/vulkan_deletion_queue.h"
 #include "util/timer.h"
+#include "util/range_allocator.h"
+#include "util/mesh_processing.h"
+
+#include <vector>
+#include <algorithm>
 
 uint32_t VulkanBuffers::maxAllocations = 0, VulkanBuffers::currentAllocations = 0;
 
-VkCommandBuffer VulkanBuffers::commandBuffer = nullptr; // Cleaned automatically by command pool clean.
-VkBuffer VulkanBuffers::vertexBuffer[] = {nullptr, nullptr, nullptr};
-uint32_t VulkanBuffers::vertexCount[] = {0, 0, 0};
-VkBuffer VulkanBuffers::indexBuffer[] = {nullptr, nullptr, nullptr};
-uint32_t VulkanBuffers::indexCount[] = {0, 0, 0};
-uint32_t VulkanBuffers::meshBufferToUse = 0;
+std::vector<VkCommandBuffer> VulkanBuffers::commandBuffers{}; // Cleaned automatically by command pool clean.
+VkBuffer VulkanBuffers::vertexBuffer = nullptr;
+VkBuffer VulkanBuffers::indexBuffer = nullptr;
 
-extern const uint32_t VulkanBuffers::UBO_BUFFER_COUNT = 2;
+extern const uint32_t VulkanBuffers::UBO_BUFFER_COUNT = MAX_FRAMES_IN_FLIGHT;
+extern const uint32_t VulkanBuffers::UPLOAD_COMMAND_BUFFER_COUNT = 3;
+extern const uint32_t VulkanBuffers::MAX_INSTANCES = 65536; // 8MB per frame
+extern const uint32_t VulkanBuffers::MAX_CLUSTERS = 262144; // 12MB, 64M triangles
+// Every cluster of every mesh drawn once, plus every instance. 6.25MB per frame.
+extern const uint32_t VulkanBuffers::MAX_DRAWS = VulkanBuffers::MAX_CLUSTERS + VulkanBuffers::MAX_INSTANCES;
 extern const uint32_t VulkanBuffers::DEFAULT_ALLOCATION_SIZE = FROM_MB(256); // 128MB is not enough
-
-uint32_t VulkanBuffers::uniformBufferIndex = UBO_BUFFER_COUNT;
+// As much as the three fixed mesh buffers this replaced: One large mesh and two simplified versions of it
+extern const VkDeviceSize VulkanBuffers::MESH_BUFFER_SIZE = 3 * static_cast<VkDeviceSize>(DEFAULT_ALLOCATION_SIZE);
 
 VkPhysicalDeviceMemoryProperties VulkanBuffers::memProperties{};
 
-VkDeviceMemory VulkanBuffers::vertexBufferMemory[] = {nullptr, nullptr, nullptr};
-VkDeviceMemory VulkanBuffers::indexBufferMemory[] = {nullptr, nullptr, nullptr};
-std::vector<VkBuffer> VulkanBuffers::uniformBuffers{};
-std::vector<VkDeviceMemory> VulkanBuffers::uniformBuffersMemory{};
-std::vector<void *> VulkanBuffers::uniformBuffersMapped{};
+VkDeviceMemory VulkanBuffers::vertexBufferMemory = nullptr;
+VkDeviceMemory VulkanBuffers::indexBufferMemory = nullptr;
+VkBuffer VulkanBuffers::uniformBuffer = nullptr;
+VkDeviceMemory VulkanBuffers::uniformBufferMemory = nullptr;
+void *VulkanBuffers::uniformBufferMapped = nullptr;
+VkDeviceSize VulkanBuffers::uniformBufferStride = 0;
+VkBuffer VulkanBuffers::instanceBuffer = nullptr;
+VkDeviceMemory VulkanBuffers::instanceBufferMemory = nullptr;
+void *VulkanBuffers::instanceBufferMapped = nullptr;
+VkDeviceSize VulkanBuffers::instanceBufferStride = 0;
+VkBuffer VulkanBuffers::clusterBuffer = nullptr;
+VkDeviceMemory VulkanBuffers::clusterBufferMemory = nullptr;
+VkBuffer VulkanBuffers::cullJobBuffer = nullptr;
+VkDeviceMemory VulkanBuffers::cullJobBufferMemory = nullptr;
+void *VulkanBuffers::cullJobBufferMapped = nullptr;
+VkDeviceSize VulkanBuffers::cullJobBufferStride = 0;
+VkBuffer VulkanBuffers::indirectBuffer = nullptr;
+VkDeviceMemory VulkanBuffers::indirectBufferMemory = nullptr;
+void *VulkanBuffers::indirectBufferMapped = nullptr;
+VkDeviceSize VulkanBuffers::indirectBufferStride = 0;
 
 VkQueue VulkanBuffers::transferQueue = nullptr;
 VkCommandPool VulkanBuffers::transferCommandPool = nullptr;
 VkCommandBuffer VulkanBuffers::transferCommandBuffer = nullptr; // Cleaned automatically by command pool clean.
 
-VkFence VulkanBuffers::uploadFence = nullptr;
-bool VulkanBuffers::waitingForFence = false;
-std::vector<VkBuffer> stagingBuffersToDestroy{};
-std::vector<VkDeviceMemory> stagingBufferMemoriesToDestroy{};
-uint32_t indexCountToSet, vertexCountToSet;
-uint32_t meshBufferIndexToSet;
+// Upload command buffers can be reused once the GPU has finished the upload. Staging buffers go to the deletion queue.
+struct PendingUpload {
+    uint64_t timelineValue;
+    VkCommandBuffer commandBuffer;
+};
+
+std::vector<PendingUpload> pendingUploads{};
+std::vector<VkCommandBuffer> freeUploadCommandBuffers{};
+
+// Ranges of the shared mesh buffers, in vertices, indices and clusters
+RangeAllocator vertexAllocator{};
+RangeAllocator indexAllocator{};
+RangeAllocator clusterAllocator{};
+
+// Draw commands start after the draw count, at the alignment of VkDrawIndexedIndirectCommand arrays in cull.comp
+constexpr VkDeviceSize DRAW_COMMANDS_OFFSET = 16;
 
 void VulkanBuffers::create() {
     INF "Creating VulkanBuffers" ENDL;
@@ -60,110 +95,84 @@ void VulkanBuffers::create() {
     createVertexBuffer();
     createIndexBuffer();
     createUniformBuffers();
-    createUploadFence();
-}
-
-void destroyStagingBuffers() {
-    for (auto stagingBuffer: stagingBuffersToDestroy) {
-        vkDestroyBuffer(VulkanDevices::logical, stagingBuffer, nullptr);
-    }
-    stagingBuffersToDestroy.clear();
-
-    for (auto stagingBufferMemory: stagingBufferMemoriesToDestroy) {
-        vkFreeMemory(VulkanDevices::logical, stagingBufferMemory, nullptr);
-    }
-    stagingBufferMemoriesToDestroy.clear();
+    createInstanceBuffers();
+    createIndirectBuffers();
+    createClusterBuffer();
+    createCullJobBuffers();
+    createUploadCommandBuffers();
 }
 
 void VulkanBuffers::destroy() {
     INF "Destroying VulkanBuffers" ENDL;
 
     vkQueueWaitIdle(VulkanBuffers::transferQueue); // In case we are still uploading
-    destroyStagingBuffers();
-
-    vkDestroyFence(VulkanDevices::logical, VulkanBuffers::uploadFence, nullptr);
-
-    for (size_t i = 0; i < UBO_BUFFER_COUNT; i++) {
-        vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::uniformBuffers[i], nullptr);
-        vkFreeMemory(VulkanDevices::logical, VulkanBuffers::uniformBuffersMemory[i], nullptr);
-    }
-
-    for (auto buffer: VulkanBuffers::vertexBuffer)
-        vkDestroyBuffer(VulkanDevices::logical, buffer, nullptr);
-    for (auto bufferMemory: VulkanBuffers::vertexBufferMemory)
-        vkFreeMemory(VulkanDevices::logical, bufferMemory, nullptr);
-
-    for (auto buffer: VulkanBuffers::indexBuffer)
-        vkDestroyBuffer(VulkanDevices::logical, buffer, nullptr);
-    for (auto bufferMemory: VulkanBuffers::indexBufferMemory)
-        vkFreeMemory(VulkanDevices::logical, bufferMemory, nullptr);
+    pendingUploads.clear();
+    freeUploadCommandBuffers.clear(); // Cleaned by command pool destruction
+
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::uniformBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::uniformBufferMemory, nullptr); // Implicitly unmaps
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::instanceBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::instanceBufferMemory, nullptr);
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::indirectBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::indirectBufferMemory, nullptr);
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::cullJobBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::cullJobBufferMemory, nullptr);
+
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::vertexBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::vertexBufferMemory, nullptr);
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::indexBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::indexBufferMemory, nullptr);
+    vkDestroyBuffer(VulkanDevices::logical, VulkanBuffers::clusterBuffer, nullptr);
+    vkFreeMemory(VulkanDevices::logical, VulkanBuffers::clusterBufferMemory, nullptr);
+    vertexAllocator = RangeAllocator{};
+    indexAllocator = RangeAllocator{};
+    clusterAllocator = RangeAllocator{};
 
     vkDestroyCommandPool(VulkanDevices::logical, VulkanBuffers::transferCommandPool, nullptr);
 //    vkFreeCommandBuffers(VulkanDevices::logical, VulkanBuffers::transferCommandPool, 1, &VulkanBuffers::transferCommandBuffer);
 }
 
-void VulkanBuffers::uploadVertices(const std::vector<Vertex> &vertices, uint32_t bufferIndex) {
-    VkDeviceSize bufferSize = sizeof(Vertex) * vertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-                 &stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(VulkanDevices::logical, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(VulkanDevices::logical, stagingBufferMemory);
-
-    // +1 because -1 means that we are accessing a non-simplified buffer
-    auto dstBuffer = VulkanBuffers::vertexBuffer[bufferIndex];
-    copyBuffer(stagingBuffer, dstBuffer, bufferSize);
-
-    // Cleanup
-    vkDestroyBuffer(VulkanDevices::logical, stagingBuffer, nullptr);
-    vkFreeMemory(VulkanDevices::logical, stagingBufferMemory, nullptr);
-
-    // TODO += -> = revert
-    VulkanBuffers::vertexCount[bufferIndex] = vertices.size();
-
-    // TODO for now assume that initial buffer is only copied to once
-//    VulkanBuffers::simplifiedMeshBuffersIndex = simplifiedIndex; TODO
-}
-
-void VulkanBuffers::uploadIndices(const std::vector<uint32_t> &indices, uint32_t bufferIndex) {
-    VkDeviceSize bufferSize = sizeof(uint32_t) * indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-                 &stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(VulkanDevices::logical, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(VulkanDevices::logical, stagingBufferMemory);
-
-    // +1 because -1 means that we are accessing a non-simplified buffer
-    copyBuffer(stagingBuffer, VulkanBuffers::indexBuffer[bufferIndex], bufferSize);
-
-    vkDestroyBuffer(VulkanDevices::logical, stagingBuffer, nullptr);
-    vkFreeMemory(VulkanDevices::logical, stagingBufferMemory, nullptr);
-
-    // TODO += -> = revert
-    VulkanBuffers::indexCount[bufferIndex] = indices.size();
+MeshAllocation VulkanBuffers::uploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+    if (vertices.empty() || indices.empty()) THROW("Can not upload an empty mesh");
+    if (!canUpload()) {
+        THROW("No free upload command buffer. Check VulkanBuffers::canUpload() first!");
+    }
 
-    // TODO for now assume that initial buffer is only copied to once
-//    VulkanBuffers::simplifiedMeshBuffersIndex = simplifiedIndex; TODO
-}
+    MeshAllocation allocation{
+            .vertexCount = static_cast<uint32_t>(vertices.size()),
+            .indexCount = static_cast<uint32_t>(indices.size())
+    };
+    allocation.firstVertex = vertexAllocator.allocate(allocation.vertexCount);
+    if (allocation.firstVertex == RangeAllocator::INVALID_OFFSET) {
+        DBG "No room for " << allocation.vertexCount << " vertices in the mesh buffer" ENDL;
+        return {};
+    }
+    allocation.firstIndex = indexAllocator.allocate(allocation.indexCount);
+    if (allocation.firstIndex == RangeAllocator::INVALID_OFFSET) {
+        DBG "No room for " << allocation.indexCount << " indices in the mesh buffer" ENDL;
+        vertexAllocator.free(allocation.firstVertex, allocation.vertexCount);
+        return {};
+    }
 
-void VulkanBuffers::uploadMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
-                               bool parallel, uint32_t bufferIndex) {
+    // Culled as a whole by the CPU, or per cluster by cull.comp
+    std::vector<MeshCluster> clusters = MeshProcessing::buildClusters(vertices, indices);
+    allocation.clusterCount = static_cast<uint32_t>(clusters.size());
+    allocation.firstCluster = clusterAllocator.allocate(allocation.clusterCount);
+    if (allocation.firstCluster == RangeAllocator::INVALID_OFFSET) {
+        DBG "No room for " << allocation.clusterCount << " clusters in the cluster buffer" ENDL;
+        vertexAllocator.free(allocation.firstVertex, allocation.vertexCount);
+        indexAllocator.free(allocation.firstIndex, allocation.indexCount);
+        return {};
+    }
+    // Draws read the shared index buffer directly
+    for (auto &cluster: clusters) {
+        cluster.firstIndex += allocation.firstIndex;
+    }
 
     size_t vertexBufferSize = sizeof(Vertex) * vertices.size();
     size_t indexBufferSize = sizeof(uint32_t) * indices.size();
-    VkDeviceSize bufferSize = vertexBufferSize + indexBufferSize;
+    size_t clusterBufferSize = sizeof(MeshCluster) * clusters.size();
+    VkDeviceSize bufferSize = vertexBufferSize + indexBufferSize + clusterBufferSize;
 
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
@@ -182,51 +191,89 @@ void VulkanBuffers::uploadMesh(const std::vector<Vertex> &vertices, const std::v
     vkMapMemory(VulkanDevices::logical, stagingBufferMemory, vertexBufferSize, indexBufferSize, 0, &data);
     memcpy(data, indices.data(), (size_t) indexBufferSize);
     vkUnmapMemory(VulkanDevices::logical, stagingBufferMemory);
+    // Upload clusters
+    vkMapMemory(VulkanDevices::logical, stagingBufferMemory, vertexBufferSize + indexBufferSize, clusterBufferSize, 0,
+                &data);
+    memcpy(data, clusters.data(), clusterBufferSize);
+    vkUnmapMemory(VulkanDevices::logical, stagingBufferMemory);
 
     // To final buffer
 
+    VkCommandBuffer uploadCommandBuffer = freeUploadCommandBuffers.back();
+    freeUploadCommandBuffers.pop_back();
+
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(VulkanBuffers::transferCommandBuffer, &beginInfo);
+    vkBeginCommandBuffer(uploadCommandBuffer, &beginInfo);
 
     // Upload vertices
-    auto dstBufferVertices = VulkanBuffers::vertexBuffer[bufferIndex];
     VkBufferCopy copyRegionVertices{};
     copyRegionVertices.srcOffset = 0; // Optional
-    copyRegionVertices.dstOffset = 0; // Optional
+    copyRegionVertices.dstOffset = sizeof(Vertex) * allocation.firstVertex;
     copyRegionVertices.size = vertexBufferSize; // VK_WHOLE_SIZE  not allowed here!
-    vkCmdCopyBuffer(VulkanBuffers::transferCommandBuffer, stagingBuffer, dstBufferVertices, 1, &copyRegionVertices);
+    vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, VulkanBuffers::vertexBuffer, 1, &copyRegionVertices);
 
     // Upload indices
-    auto dstBufferIndices = VulkanBuffers::indexBuffer[bufferIndex];
     VkBufferCopy copyRegionIndices{};
     copyRegionIndices.srcOffset = vertexBufferSize; // Optional
-    copyRegionIndices.dstOffset = 0; // Optional
+    copyRegionIndices.dstOffset = sizeof(uint32_t) * allocation.firstIndex;
     copyRegionIndices.size = indexBufferSize; // VK_WHOLE_SIZE  not allowed here!
-    vkCmdCopyBuffer(VulkanBuffers::transferCommandBuffer, stagingBuffer, dstBufferIndices, 1, &copyRegionIndices);
+    vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, VulkanBuffers::indexBuffer, 1, &copyRegionIndices);
 
-    vkEndCommandBuffer(VulkanBuffers::transferCommandBuffer);
+    // Upload clusters
+    VkBufferCopy copyRegionClusters{};
+    copyRegionClusters.srcOffset = vertexBufferSize + indexBufferSize;
+    copyRegionClusters.dstOffset = sizeof(MeshCluster) * allocation.firstCluster;
+    copyRegionClusters.size = clusterBufferSize;
+    vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, VulkanBuffers::clusterBuffer, 1, &copyRegionClusters);
+
+    vkEndCommandBuffer(uploadCommandBuffer);
 
     // Submit
 
+    // Nothing to wait for: Allocated ranges are only freed once no frame or upload uses them anymore.
+    const uint64_t signalValue = VulkanTimeline::upload.next();
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &VulkanBuffers::transferCommandBuffer;
+    submitInfo.pCommandBuffers = &uploadCommandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &VulkanTimeline::upload.semaphore;
 
     START_TRACE
-    vkQueueSubmit(VulkanBuffers::transferQueue, 1, &submitInfo, uploadFence);
+    if (vkQueueSubmit(VulkanBuffers::transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        THROW("Failed to submit mesh upload!");
+    }
     END_TRACE("Queue submit")
 
     // End
-    stagingBuffersToDestroy.push_back(stagingBuffer);
-    stagingBufferMemoriesToDestroy.push_back(stagingBufferMemory);
-    waitingForFence = true;
+    pendingUploads.push_back({.timelineValue = signalValue, .commandBuffer = uploadCommandBuffer});
+    VulkanDeletionQueue::enqueue([=]() {
+        vkDestroyBuffer(VulkanDevices::logical, stagingBuffer, nullptr);
+        vkFreeMemory(VulkanDevices::logical, stagingBufferMemory, nullptr);
+    });
 
-    meshBufferIndexToSet = bufferIndex;
-    indexCountToSet = indices.size();
-    vertexCountToSet = vertices.size();
+    allocation.uploadValue = signalValue;
+    return allocation;
+}
+
+void VulkanBuffers::releaseMesh(MeshAllocation &allocation) {
+    if (!allocation.isValid()) return;
+
+    VulkanDeletionQueue::enqueue([=]() {
+        vertexAllocator.free(allocation.firstVertex, allocation.vertexCount);
+        indexAllocator.free(allocation.firstIndex, allocation.indexCount);
+        clusterAllocator.free(allocation.firstCluster, allocation.clusterCount);
+    });
+    allocation = {};
 }
 
 void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, bool parallel) {
@@ -265,103 +312,186 @@ void VulkanBuffers::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceS
 //    vkFreeCommandBuffers(logical, VulkanBuffers::transferCommandPool, 1, &VulkanBuffers::transferCommandBuffer);
 }
 
-void VulkanBuffers::waitForTransfer() {
-    VkResult result = vkWaitForFences(VulkanDevices::logical, 1, &VulkanBuffers::uploadFence, true,
-                                      30'000'000'000); // Wait for 30s max
-    if (result != VK_SUCCESS) {
-        THROW("Waiting for the upload fence was unsuccessful");
-    }
-    finishTransfer();
+bool VulkanBuffers::canEverFitMesh(size_t vertexCount, size_t indexCount) {
+    return vertexCount <= MESH_BUFFER_SIZE / sizeof(Vertex) && indexCount <= MESH_BUFFER_SIZE / sizeof(uint32_t) &&
+           MeshProcessing::getClusterCount(indexCount) <= MAX_CLUSTERS;
 }
 
-void VulkanBuffers::finishTransfer() {
-    vkResetFences(VulkanDevices::logical, 1, &VulkanBuffers::uploadFence);
-    destroyStagingBuffers();
-    waitingForFence = false;
-    VulkanBuffers::meshBufferToUse = meshBufferIndexToSet;
-    VulkanBuffers::indexCount[meshBufferIndexToSet] = indexCountToSet;
-    VulkanBuffers::vertexCount[meshBufferIndexToSet] = vertexCountToSet;
+bool VulkanBuffers::canUpload() {
+    return !freeUploadCommandBuffers.empty();
 }
 
-bool VulkanBuffers::isTransferQueueReady() {
-    if (!waitingForFence) return true;
+void VulkanBuffers::reclaimFinishedUploads() {
+    if (pendingUploads.empty()) return;
 
-    VkResult result = vkGetFenceStatus(VulkanDevices::logical, VulkanBuffers::uploadFence);
-    if (result == VK_SUCCESS) {
+    const uint64_t completed = VulkanTimeline::completedValue(VulkanTimeline::upload);
+    std::erase_if(pendingUploads, [=](const PendingUpload &upload) {
+        if (upload.timelineValue > completed) return false;
+        freeUploadCommandBuffers.push_back(upload.commandBuffer);
         return true;
-    } else if (result == VK_ERROR_DEVICE_LOST) {
-        THROW("Device lost when checking fence");
-    } else {
-        return false;
-    }
+    });
 }
 
-void VulkanBuffers::createUploadFence() {
-    VkFenceCreateInfo createInfo{
-            .sType=VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .flags=0
-    };
-    if (vkCreateFence(VulkanDevices::logical, &createInfo, nullptr, &VulkanBuffers::uploadFence) != VK_SUCCESS) {
-        THROW("Failed to create upload fence");
+void VulkanBuffers::createUploadCommandBuffers() {
+    freeUploadCommandBuffers.resize(UPLOAD_COMMAND_BUFFER_COUNT);
+    for (auto &buffer: freeUploadCommandBuffers) {
+        createCommandBuffer(VulkanBuffers::transferCommandPool, &buffer);
     }
 }
 
-void VulkanBuffers::destroyCommandBuffer(VkCommandPool commandPool) {
-    vkFreeCommandBuffers(VulkanDevices::logical, commandPool, 1, &VulkanBuffers::commandBuffer);
+void VulkanBuffers::destroyCommandBuffers(VkCommandPool commandPool) {
+    vkFreeCommandBuffers(VulkanDevices::logical, commandPool,
+                         static_cast<uint32_t>(VulkanBuffers::commandBuffers.size()),
+                         VulkanBuffers::commandBuffers.data());
+    VulkanBuffers::commandBuffers.clear();
 }
 
-void VulkanBuffers::nextUniformBuffer() {
-    VulkanBuffers::uniformBufferIndex = (VulkanBuffers::uniformBufferIndex + 1) % UBO_BUFFER_COUNT;
+void *VulkanBuffers::getUniformBufferMapping(uint32_t frame) {
+    return static_cast<char *>(VulkanBuffers::uniformBufferMapped) + getUniformBufferOffset(frame);
 }
 
-void *VulkanBuffers::getCurrentUniformBufferMapping() {
-    return VulkanBuffers::uniformBuffersMapped[VulkanBuffers::uniformBufferIndex];
+uint32_t VulkanBuffers::getUniformBufferOffset(uint32_t frame) {
+    return static_cast<uint32_t>(frame * VulkanBuffers::uniformBufferStride);
 }
 
-VkBuffer VulkanBuffers::getCurrentUniformBuffer() {
-    return VulkanBuffers::uniformBuffers[VulkanBuffers::uniformBufferIndex];
+InstanceData *VulkanBuffers::getInstanceBufferMapping(uint32_t frame) {
+    return reinterpret_cast<InstanceData *>(static_cast<char *>(VulkanBuffers::instanceBufferMapped) +
+                                            getInstanceBufferOffset(frame));
 }
 
-void VulkanBuffers::createVertexBuffer() {
-    VkDeviceSize bufferSize = DEFAULT_ALLOCATION_SIZE;
+uint32_t VulkanBuffers::getInstanceBufferOffset(uint32_t frame) {
+    return static_cast<uint32_t>(frame * VulkanBuffers::instanceBufferStride);
+}
 
-    for (int i = 0; i < 3; ++i)
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VulkanBuffers::vertexBuffer + i,
-                     VulkanBuffers::vertexBufferMemory + i);
+VkDrawIndexedIndirectCommand *VulkanBuffers::getDrawCommandMapping(uint32_t frame) {
+    return reinterpret_cast<VkDrawIndexedIndirectCommand *>(static_cast<char *>(VulkanBuffers::indirectBufferMapped) +
+                                                            getDrawCommandOffset(frame));
 }
 
-void VulkanBuffers::createIndexBuffer() {
-    VkDeviceSize bufferSize = DEFAULT_ALLOCATION_SIZE;
+uint32_t *VulkanBuffers::getDrawCountMapping(uint32_t frame) {
+    return reinterpret_cast<uint32_t *>(static_cast<char *>(VulkanBuffers::indirectBufferMapped) +
+                                        getDrawCountOffset(frame));
+}
 
-    for (int i = 0; i < 3; ++i)
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VulkanBuffers::indexBuffer + i,
-                     VulkanBuffers::indexBufferMemory + i);
+VkDeviceSize VulkanBuffers::getDrawCommandOffset(uint32_t frame) {
+    return getDrawCountOffset(frame) + DRAW_COMMANDS_OFFSET;
+}
+
+VkDeviceSize VulkanBuffers::getDrawCountOffset(uint32_t frame) {
+    return frame * VulkanBuffers::indirectBufferStride;
+}
+
+CullJob *VulkanBuffers::getCullJobMapping(uint32_t frame) {
+    return reinterpret_cast<CullJob *>(static_cast<char *>(VulkanBuffers::cullJobBufferMapped) +
+                                       getCullJobOffset(frame));
+}
+
+uint32_t VulkanBuffers::getCullJobOffset(uint32_t frame) {
+    return static_cast<uint32_t>(frame * VulkanBuffers::cullJobBufferStride);
+}
+
+void VulkanBuffers::createVertexBuffer() {
+    createBuffer(MESH_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &VulkanBuffers::vertexBuffer, &VulkanBuffers::vertexBufferMemory);
+    vertexAllocator = RangeAllocator{static_cast<uint32_t>(MESH_BUFFER_SIZE / sizeof(Vertex))};
+}
+
+void VulkanBuffers::createIndexBuffer() {
+    createBuffer(MESH_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &VulkanBuffers::indexBuffer, &VulkanBuffers::indexBufferMemory);
+    indexAllocator = RangeAllocator{static_cast<uint32_t>(MESH_BUFFER_SIZE / sizeof(uint32_t))};
 }
 
 void VulkanBuffers::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-    // One to be written, one to be read!
-    VulkanBuffers::uniformBuffers.resize(UBO_BUFFER_COUNT);
-    VulkanBuffers::uniformBuffersMemory.resize(UBO_BUFFER_COUNT);
-    VulkanBuffers::uniformBuffersMapped.resize(UBO_BUFFER_COUNT);
-
-    for (size_t i = 0; i < UBO_BUFFER_COUNT; i++) {
-        // Instead of memcopy, because it is written to every frame!
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     &VulkanBuffers::uniformBuffers[i], &VulkanBuffers::uniformBuffersMemory[i]);
-
-        // Persistent mapping:
-        vkMapMemory(VulkanDevices::logical, VulkanBuffers::uniformBuffersMemory[i], 0, bufferSize, 0,
-                    &VulkanBuffers::uniformBuffersMapped[i]);
-    }
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &deviceProperties);
+
+    // Dynamic offsets have to be multiples of minUniformBufferOffsetAlignment, which is a power of two
+    const VkDeviceSize alignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
+    VulkanBuffers::uniformBufferStride = (sizeof(UniformBufferObject) + alignment - 1) & ~(alignment - 1);
+
+    // One slot per frame in flight, so the CPU never writes a slot the GPU is still reading
+    VkDeviceSize bufferSize = VulkanBuffers::uniformBufferStride * UBO_BUFFER_COUNT;
+
+    // Instead of memcopy, because it is written to every frame!
+    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &VulkanBuffers::uniformBuffer, &VulkanBuffers::uniformBufferMemory);
+
+    // Persistent mapping:
+    vkMapMemory(VulkanDevices::logical, VulkanBuffers::uniformBufferMemory, 0, bufferSize, 0,
+                &VulkanBuffers::uniformBufferMapped);
 }
 
-void VulkanBuffers::createCommandBuffer(VkCommandPool commandPool) {
-    createCommandBuffer(commandPool, &VulkanBuffers::commandBuffer);
+void VulkanBuffers::createInstanceBuffers() {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &deviceProperties);
+
+    const VkDeviceSize alignment = deviceProperties.limits.minStorageBufferOffsetAlignment;
+    VulkanBuffers::instanceBufferStride =
+            (sizeof(InstanceData) * VulkanBuffers::MAX_INSTANCES + alignment - 1) & ~(alignment - 1);
+
+    // Rewritten by the CPU every frame, same as the uniform buffer
+    VkDeviceSize bufferSize = VulkanBuffers::instanceBufferStride * MAX_FRAMES_IN_FLIGHT;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &VulkanBuffers::instanceBuffer, &VulkanBuffers::instanceBufferMemory);
+
+    vkMapMemory(VulkanDevices::logical, VulkanBuffers::instanceBufferMemory, 0, bufferSize, 0,
+                &VulkanBuffers::instanceBufferMapped);
+}
+
+void VulkanBuffers::createIndirectBuffers() {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &deviceProperties);
+
+    // Indirect buffer offsets only have to be multiples of 4, but cull.comp binds every frame's region with a
+    // dynamic offset
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(deviceProperties.limits.minStorageBufferOffsetAlignment, 16);
+    VulkanBuffers::indirectBufferStride =
+            (DRAW_COMMANDS_OFFSET + sizeof(VkDrawIndexedIndirectCommand) * VulkanBuffers::MAX_DRAWS + alignment - 1) &
+            ~(alignment - 1);
+
+    // Rewritten every frame, by the CPU or by cull.comp
+    VkDeviceSize bufferSize = VulkanBuffers::indirectBufferStride * MAX_FRAMES_IN_FLIGHT;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &VulkanBuffers::indirectBuffer, &VulkanBuffers::indirectBufferMemory);
+
+    vkMapMemory(VulkanDevices::logical, VulkanBuffers::indirectBufferMemory, 0, bufferSize, 0,
+                &VulkanBuffers::indirectBufferMapped);
+}
+
+void VulkanBuffers::createClusterBuffer() {
+    createBuffer(sizeof(MeshCluster) * MAX_CLUSTERS, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &VulkanBuffers::clusterBuffer,
+                 &VulkanBuffers::clusterBufferMemory);
+    clusterAllocator = RangeAllocator{MAX_CLUSTERS};
+}
+
+void VulkanBuffers::createCullJobBuffers() {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &deviceProperties);
+
+    const VkDeviceSize alignment = deviceProperties.limits.minStorageBufferOffsetAlignment;
+    VulkanBuffers::cullJobBufferStride =
+            (sizeof(CullJob) * VulkanBuffers::MAX_INSTANCES + alignment - 1) & ~(alignment - 1);
+
+    // Rewritten by the CPU every frame, same as the instance buffer
+    VkDeviceSize bufferSize = VulkanBuffers::cullJobBufferStride * MAX_FRAMES_IN_FLIGHT;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &VulkanBuffers::cullJobBuffer, &VulkanBuffers::cullJobBufferMemory);
+
+    vkMapMemory(VulkanDevices::logical, VulkanBuffers::cullJobBufferMemory, 0, bufferSize, 0,
+                &VulkanBuffers::cullJobBufferMapped);
+}
+
+void VulkanBuffers::createCommandBuffers(VkCommandPool commandPool) {
+    VulkanBuffers::commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    for (auto &buffer: VulkanBuffers::commandBuffers) {
+        createCommandBuffer(commandPool, &buffer);
+    }
 }
 
 void VulkanBuffers::createCommandBuffer(VkCommandPool commandPool, VkCommandBuffer *pBuffer) {
@@ -429,8 +559,4 @@ void VulkanBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Vk
 
     // offset % memRequirements.alignment == 0
     vkBindBufferMemory(VulkanDevices::logical, *pBuffer, *pBufferMemory, 0);
-}
-
-void VulkanBuffers::resetMeshBufferToUse() {
-    VulkanBuffers::meshBufferToUse = 0;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+//
+// Created by Saman on 29.09.23.
+//
+
+#include "graphics/vulkan/vulkan_deletion_queue.h"
+#include "graphics/vulkan/vulkan_timeline.h"
+#include "io/printer.h"
+
+#include <deque>
+
+struct PendingDeletion {
+    uint64_t renderValue = 0; // Render timeline value of the last frame that could use the resource
+    uint64_t uploadValue = 0; // Upload timeline value of the last upload that could use the resource
+    std::function<void()> deleter{};
+};
+
+// Timeline values only grow, so the oldest entries are always the first to become ready
+std::deque<PendingDeletion> pendingDeletions{};
+
+void VulkanDeletionQueue::enqueue(std::function<void()> &&deleter) {
+    pendingDeletions.push_back({
+                                       .renderValue = VulkanTimeline::render.lastSubmittedValue,
+                                       .uploadValue = VulkanTimeline::upload.lastSubmittedValue,
+                                       .deleter = std::move(deleter)
+                               });
+}
+
+void VulkanDeletionQueue::collect() {
+    if (pendingDeletions.empty()) return;
+
+    const uint64_t completedRender = VulkanTimeline::completedValue(VulkanTimeline::render);
+    const uint64_t completedUpload = VulkanTimeline::completedValue(VulkanTimeline::upload);
+    while (!pendingDeletions.empty()) {
+        const auto &deletion = pendingDeletions.front();
+        if (deletion.renderValue > completedRender || deletion.uploadValue > completedUpload) break;
+        deletion.deleter();
+        pendingDeletions.pop_front();
+    }
+}
+
+void VulkanDeletionQueue::destroy() {
+    INF "Destroying VulkanDeletionQueue" ENDL;
+
+    for (const auto &deletion: pendingDeletions) {
+        deletion.deleter();
+    }
+    pendingDeletions.clear();
+}
+
+size_t VulkanDeletionQueue::getPendingCount() {
+    return pendingDeletions.size();
+}
@@ -84,6 +84,28 @@ void VulkanDevices::pickPhysical() {
     VkPhysicalDeviceFeatures deviceFeatures;
     vkGetPhysicalDeviceFeatures(VulkanDevices::physical, &deviceFeatures);
     VulkanDevices::optionalFeatures.supportsWireframeMode = deviceFeatures.fillModeNonSolid;
+    VulkanDevices::optionalFeatures.supportsMultiDrawIndirect = deviceFeatures.multiDrawIndirect;
+    VulkanDevices::optionalFeatures.supportsDrawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(VulkanDevices::physical, &features);
+    VulkanDevices::optionalFeatures.supportsDrawIndirectCount = vulkan12Features.drawIndirectCount;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(VulkanDevices::physical, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(VulkanDevices::physical, &queueFamilyCount, queueFamilies.data());
+    VulkanDevices::optionalFeatures.supportsGraphicsQueueCompute =
+            queueFamilies[VulkanDevices::queueFamilyIndices.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT;
+
+    VRB "Multi draw indirect: " << VulkanDevices::optionalFeatures.supportsMultiDrawIndirect
+        << ", draw indirect count: " << VulkanDevices::optionalFeatures.supportsDrawIndirectCount
+        << ", draw indirect first instance: " << VulkanDevices::optionalFeatures.supportsDrawIndirectFirstInstance
+        << ", compute on the graphics queue: " << VulkanDevices::optionalFeatures.supportsGraphicsQueueCompute ENDL;
 }
 
 bool VulkanDevices::isPhysicalDeviceSuitable(VkPhysicalDevice device, bool strictMode) {
@@ -106,6 +128,10 @@ bool VulkanDevices::isPhysicalDeviceSuitable(VkPhysicalDevice device, bool stric
     // Supports required extensions
     suitable = suitable && checkExtensionSupport(device);
 
+    // Supports required Vulkan 1.2 features
+    suitable = suitable && deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    suitable = suitable && checkFeatureSupport(device);
+
     // Supports required swapchain features
     auto swapchainSupport = VulkanSwapchain::querySwapchainSupport(device);
     bool swapchainAdequate = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
@@ -137,6 +163,18 @@ bool VulkanDevices::checkExtensionSupport(VkPhysicalDevice device) {
     return requiredExtensions.empty();
 }
 
+bool VulkanDevices::checkFeatureSupport(VkPhysicalDevice device) {
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
 bool VulkanDevices::checkPortabilityMode(VkPhysicalDevice device) {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -212,10 +250,20 @@ void VulkanDevices::createLogical() {
     // Define the features we will use as queried in isPhysicalDeviceSuitable
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.fillModeNonSolid = VulkanDevices::optionalFeatures.supportsWireframeMode;
+    deviceFeatures.multiDrawIndirect = VulkanDevices::optionalFeatures.supportsMultiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = VulkanDevices::optionalFeatures.supportsDrawIndirectFirstInstance;
+
+    // Uploads and frames are synchronized via timeline semaphores.
+    // Can not be combined with VkPhysicalDeviceTimelineSemaphoreFeatures, which it contains.
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    vulkan12Features.drawIndirectCount = VulkanDevices::optionalFeatures.supportsDrawIndirectCount;
 
     VkDeviceCreateInfo createInfo{};
 
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &vulkan12Features;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -9,7 +9,8 @@
 #include "graphics/vulkan/vulkan_devices.h"
 #include "graphics/vulkan/vulkan_swapchain.h"
 #include "graphics/vulkan/vulkan_renderpasses.h"
-#include "graphics/vulkan/vulkan_buffers.h"
+#include "graphics/vulkan/vulkan_pipeline_cache.h"
+#include "graphics/vulkan/vulkan_timeline.h"
 #include "graphics/ui.h"
 
 #include <imgui_impl_vulkan.h>
@@ -30,6 +31,66 @@ static void checkVkResult(VkResult err) {
     }
 }
 
+// Creates the Vulkan side of ImGui against the current render pass, including the font texture
+static void initRenderer() {
+    ImGui_ImplVulkan_InitInfo initInfo = {};
+    initInfo.Instance = VulkanInstance::instance;
+    initInfo.PhysicalDevice = VulkanDevices::physical;
+    initInfo.Device = VulkanDevices::logical;
+    initInfo.QueueFamily = VulkanDevices::queueFamilyIndices.graphicsFamily.value();
+    initInfo.Queue = VulkanDevices::graphicsQueue;
+    initInfo.DescriptorPool = uiDescriptorPool; // TODO
+    initInfo.Subpass = 0;
+    initInfo.PipelineCache = VulkanPipelineCache::cache;
+    initInfo.MinImageCount = VulkanSwapchain::minImageCount;
+    initInfo.ImageCount = VulkanSwapchain::imageCount;
+    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    initInfo.CheckVkResultFn = checkVkResult;
+    ImGui_ImplVulkan_Init(&initInfo, VulkanRenderPasses::renderPass);
+
+    // Fonts:
+    // A pool of its own, since mesh uploads may be recording in the transfer pool by the time this is recreated
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = VulkanDevices::queueFamilyIndices.graphicsFamily.value();
+    VkCommandPool command_pool;
+    checkVkResult(vkCreateCommandPool(VulkanDevices::logical, &poolInfo, nullptr, &command_pool));
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = command_pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer command_buffer;
+    checkVkResult(vkAllocateCommandBuffers(VulkanDevices::logical, &allocInfo, &command_buffer));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    checkVkResult(vkBeginCommandBuffer(command_buffer, &beginInfo));
+
+    ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
+
+    VkSubmitInfo endInfo = {};
+    endInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    endInfo.commandBufferCount = 1;
+    endInfo.pCommandBuffers = &command_buffer;
+    checkVkResult(vkEndCommandBuffer(command_buffer));
+
+    // Only wait for this submission, not for the frames and uploads that may be in flight
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    checkVkResult(vkCreateFence(VulkanDevices::logical, &fenceInfo, nullptr, &fence));
+    checkVkResult(vkQueueSubmit(VulkanDevices::graphicsQueue, 1, &endInfo, fence));
+    checkVkResult(vkWaitForFences(VulkanDevices::logical, 1, &fence, VK_TRUE, UINT64_MAX));
+
+    vkDestroyFence(VulkanDevices::logical, fence, nullptr);
+    vkDestroyCommandPool(VulkanDevices::logical, command_pool, nullptr);
+    ImGui_ImplVulkan_DestroyFontUploadObjects();
+}
+
 void VulkanImgui::create(RenderState &state) {
     INF "Creating VulkanImgui" ENDL;
 
@@ -63,44 +124,20 @@ void VulkanImgui::create(RenderState &state) {
 
     // Renderer:
     ImGui_ImplGlfw_InitForVulkan(state.window, true);
-    ImGui_ImplVulkan_InitInfo initInfo = {};
-    initInfo.Instance = VulkanInstance::instance;
-    initInfo.PhysicalDevice = VulkanDevices::physical;
-    initInfo.Device = VulkanDevices::logical;
-    initInfo.QueueFamily = VulkanDevices::queueFamilyIndices.graphicsFamily.value();
-    initInfo.Queue = VulkanDevices::graphicsQueue;
-    initInfo.DescriptorPool = uiDescriptorPool; // TODO
-    initInfo.Subpass = 0;
-    initInfo.MinImageCount = VulkanSwapchain::minImageCount;
-    initInfo.ImageCount = VulkanSwapchain::imageCount;
-    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
-    initInfo.CheckVkResultFn = checkVkResult;
-    ImGui_ImplVulkan_Init(&initInfo, VulkanRenderPasses::renderPass);
-
-    // Fonts:
-    VkCommandPool command_pool = VulkanBuffers::transferCommandPool;
-    VkCommandBuffer command_buffer = VulkanBuffers::transferCommandBuffer;
+    initRenderer();
 
-    checkVkResult(vkResetCommandPool(VulkanDevices::logical, command_pool, 0));
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    checkVkResult(vkBeginCommandBuffer(command_buffer, &beginInfo));
-
-    ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
+    VulkanImgui::recalculateScale(state);
+}
 
-    VkSubmitInfo endInfo = {};
-    endInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    endInfo.commandBufferCount = 1;
-    endInfo.pCommandBuffers = &command_buffer;
-    checkVkResult(vkEndCommandBuffer(command_buffer));
-    // TODO arbitrarily picked this queue because it was global
-    checkVkResult(vkQueueSubmit(VulkanBuffers::transferQueue, 1, &endInfo, VK_NULL_HANDLE));
+void VulkanImgui::recreateRenderer() {
+    DBG "Recreating the VulkanImgui pipeline" ENDL;
 
-    checkVkResult(vkDeviceWaitIdle(VulkanDevices::logical));
-    ImGui_ImplVulkan_DestroyFontUploadObjects();
+    // The backend destroys its pipeline and font texture right away, so no frame in flight may still draw the UI.
+    // Only happens when the render pass changes, which is rare enough to wait for.
+    VulkanTimeline::wait(VulkanTimeline::render, VulkanTimeline::render.lastSubmittedValue);
 
-    VulkanImgui::recalculateScale(state);
+    ImGui_ImplVulkan_Shutdown();
+    initRenderer();
 }
 
 void VulkanImgui::recalculateScale(RenderState &state) {
@@ -114,7 +151,7 @@ void VulkanImgui::recalculateScale(RenderState &state) {
     scaleVec2 = {scale, scale};
 }
 
-void VulkanImgui::draw(RenderState &state) {
+void VulkanImgui::draw(RenderState &state, VkCommandBuffer commandBuffer) {
     int width, height;
     glfwGetFramebufferSize(state.window, &width, &height);
     ImGui::GetIO().DisplaySize = {static_cast<float>(VulkanSwapchain::framebufferWidth),
@@ -132,7 +169,7 @@ void VulkanImgui::draw(RenderState &state) {
     ImGui::Render();
     ImDrawData *draw_data = ImGui::GetDrawData();
     draw_data->FramebufferScale = scaleVec2;
-    ImGui_ImplVulkan_RenderDrawData(draw_data, VulkanBuffers::commandBuffer);
+    ImGui_ImplVulkan_RenderDrawData(draw_data, commandBuffer);
 }
 
 void VulkanImgui::destroy() {
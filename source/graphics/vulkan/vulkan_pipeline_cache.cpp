@@ -0,0 +1,117 @@
+//
+// Created by Saman on 17.09.23.
+//
+
+#include "graphics/vulkan/vulkan_pipeline_cache.h"
+#include "graphics/vulkan/vulkan_devices.h"
+#include "io/printer.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+const std::string VulkanPipelineCache::CACHE_FILE = "pipeline_cache.bin";
+
+VkPipelineCache VulkanPipelineCache::cache = nullptr;
+
+// Drivers validate their own data too, but not all of them do it reliably
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t dataSize;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+constexpr uint32_t CACHE_FILE_MAGIC = 0x43504352; // "RCPC"
+
+CacheFileHeader expectedHeader() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(VulkanDevices::physical, &properties);
+
+    CacheFileHeader header{};
+    header.magic = CACHE_FILE_MAGIC;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+std::vector<char> readCacheFile() {
+    std::ifstream file(VulkanPipelineCache::CACHE_FILE, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        VRB "No pipeline cache found" ENDL;
+        return {};
+    }
+    const auto fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    CacheFileHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    const auto expected = expectedHeader();
+    if (!file || header.magic != expected.magic || header.vendorID != expected.vendorID ||
+        header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion ||
+        memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        DBG "Pipeline cache was created by a different device or driver, ignoring it" ENDL;
+        return {};
+    }
+
+    // A corrupted size must not turn into a huge allocation
+    if (fileSize < sizeof(header) || header.dataSize > fileSize - sizeof(header)) {
+        DBG "Pipeline cache is truncated, ignoring it" ENDL;
+        return {};
+    }
+
+    std::vector<char> data(header.dataSize);
+    file.read(data.data(), header.dataSize);
+    if (!file) {
+        DBG "Pipeline cache is truncated, ignoring it" ENDL;
+        return {};
+    }
+
+    return data;
+}
+
+void VulkanPipelineCache::create() {
+    INF "Creating VulkanPipelineCache" ENDL;
+
+    auto data = readCacheFile();
+    VRB "Loaded pipeline cache with byte size: " << data.size() ENDL;
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(VulkanDevices::logical, &createInfo, nullptr, &VulkanPipelineCache::cache) !=
+        VK_SUCCESS) {
+        THROW("Failed to create pipeline cache!");
+    }
+}
+
+void VulkanPipelineCache::destroy() {
+    INF "Destroying VulkanPipelineCache" ENDL;
+
+    size_t dataSize = 0;
+    vkGetPipelineCacheData(VulkanDevices::logical, VulkanPipelineCache::cache, &dataSize, nullptr);
+    std::vector<char> data(dataSize);
+    if (dataSize > 0 &&
+        vkGetPipelineCacheData(VulkanDevices::logical, VulkanPipelineCache::cache, &dataSize, data.data()) ==
+        VK_SUCCESS) {
+        auto header = expectedHeader();
+        header.dataSize = static_cast<uint32_t>(dataSize);
+
+        // Not being able to write the cache only costs startup time next launch
+        std::ofstream file(VulkanPipelineCache::CACHE_FILE, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        if (!file) {
+            DBG "Failed to write pipeline cache" ENDL;
+        }
+    }
+
+    vkDestroyPipelineCache(VulkanDevices::logical, VulkanPipelineCache::cache, nullptr);
+    VulkanPipelineCache::cache = nullptr;
+}
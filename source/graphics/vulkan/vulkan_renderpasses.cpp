@@ -88,4 +88,5 @@ void VulkanRenderPasses::destroy() {
     INF "Destroying VulkanRenderPasses" ENDL;
 
     vkDestroyRenderPass(VulkanDevices::logical, VulkanRenderPasses::renderPass, nullptr);
+    VulkanRenderPasses::renderPass = nullptr;
 }
\ No newline at end of file
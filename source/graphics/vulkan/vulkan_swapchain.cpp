@@ -10,6 +10,7 @@
 #include "graphics/vulkan/vulkan_memory.h"
 #include "graphics/vulkan/vulkan_imgui.h"
 #include "graphics/vulkan/vulkan_images.h"
+#include "graphics/vulkan/vulkan_timeline.h"
 
 #include <glfw/glfw3.h>
 #include <array>
@@ -27,6 +28,7 @@ std::vector<VkImage> VulkanSwapchain::images{};
 std::vector<VkImageView> VulkanSwapchain::imageViews{};
 std::vector<VkFramebuffer> VulkanSwapchain::framebuffers{};
 bool VulkanSwapchain::needsNewSwapchain = false;
+bool VulkanSwapchain::hasNewRenderPass = false;
 uint32_t VulkanSwapchain::minImageCount = 2;
 uint32_t VulkanSwapchain::imageCount = 2;
 
@@ -37,6 +39,42 @@ VkImageView VulkanSwapchain::depthImageView = nullptr;
 // Local
 GLFWwindow *window = nullptr;
 
+// Swapchain resources that were replaced, but may still be used by frames in flight
+struct RetiredResources {
+    uint64_t renderValue = 0; // Render timeline value of the last frame that could use these
+    // Render timeline value of a frame that proves the presentation engine is done with the swapchain images.
+    // 0 until such a frame is submitted. Not needed without a swapchain.
+    uint64_t presentedValue = 0;
+    VkSwapchainKHR swapchain = nullptr;
+    std::vector<VkImageView> imageViews{};
+    std::vector<VkFramebuffer> framebuffers{};
+    VkImage depthImage = nullptr;
+    VkDeviceMemory depthImageMemory = nullptr;
+    VkImageView depthImageView = nullptr;
+    VkRenderPass renderPass = nullptr;
+};
+
+std::vector<RetiredResources> retiredResources{};
+
+// Which images of the current swapchain have been queued for presentation at least once
+std::vector<bool> isImagePresented{};
+
+void destroyRetiredResources(const RetiredResources &resources) {
+    for (auto framebuffer: resources.framebuffers) {
+        vkDestroyFramebuffer(VulkanDevices::logical, framebuffer, nullptr);
+    }
+    vkDestroyRenderPass(VulkanDevices::logical, resources.renderPass, nullptr);
+
+    vkDestroyImageView(VulkanDevices::logical, resources.depthImageView, nullptr);
+    vkDestroyImage(VulkanDevices::logical, resources.depthImage, nullptr);
+    vkFreeMemory(VulkanDevices::logical, resources.depthImageMemory, nullptr);
+
+    for (auto imageView: resources.imageViews) {
+        vkDestroyImageView(VulkanDevices::logical, imageView, nullptr);
+    }
+    vkDestroySwapchainKHR(VulkanDevices::logical, resources.swapchain, nullptr);
+}
+
 VulkanSwapchain::SwapchainSupportDetails VulkanSwapchain::querySwapchainSupport(VkPhysicalDevice device) {
     SwapchainSupportDetails details;
 
@@ -71,13 +109,19 @@ void VulkanSwapchain::createSurface(GLFWwindow *w) {
 VkSurfaceFormatKHR VulkanSwapchain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats) {
     VkSurfaceFormatKHR out = availableFormats[0];
 
+    // Shaders output linear colors and rely on the swapchain to do the sRGB encoding
     for (const auto &availableFormat: availableFormats) {
-        if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
+        if ((availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB || availableFormat.format == VK_FORMAT_R8G8B8A8_SRGB) &&
             availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
             out = availableFormat;
+            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB) break;
         }
     }
 
+    if (out.format != VK_FORMAT_B8G8R8A8_SRGB && out.format != VK_FORMAT_R8G8B8A8_SRGB) {
+        DBG "No sRGB swapchain format available, colors will appear too dark" ENDL;
+    }
+
     VRB "Picked Swapchain Surface Format: " ENDL;
     VRB "\tFormat: " << out.format ENDL;
     VRB "\tColor Space: " << out.colorSpace ENDL;
@@ -145,22 +189,57 @@ VkExtent2D VulkanSwapchain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &cap
 bool VulkanSwapchain::recreateSwapchain(RenderState &state) {
     VRB "Recreating Swapchain" ENDL;
 
-    // May need to recreate render pass here if e.g. window moves to HDR monitor
-
-    vkDeviceWaitIdle(VulkanDevices::logical);
-
-    destroySwapchain();
+    collectRetiredResources();
+
+    // Every frame submitted so far may still be using the current resources
+    RetiredResources retired{
+            .renderValue = VulkanTimeline::render.lastSubmittedValue,
+            .swapchain = VulkanSwapchain::swapchain,
+            .imageViews = VulkanSwapchain::imageViews,
+            .framebuffers = VulkanSwapchain::framebuffers,
+            .depthImage = VulkanSwapchain::depthImage,
+            .depthImageMemory = VulkanSwapchain::depthImageMemory,
+            .depthImageView = VulkanSwapchain::depthImageView
+    };
 
-    auto success = createSwapchain();
+    // Leaves the current resources untouched if it fails
+    auto success = createSwapchain(retired.swapchain);
 
     if (success) {
+        retiredResources.push_back(std::move(retired));
         VulkanImgui::recalculateScale(state);
     }
 
     return success;
 }
 
-bool VulkanSwapchain::createSwapchain() {
+void VulkanSwapchain::collectRetiredResources() {
+    if (retiredResources.empty()) return;
+
+    const uint64_t completed = VulkanTimeline::completedValue(VulkanTimeline::render);
+    std::erase_if(retiredResources, [=](const RetiredResources &resources) {
+        if (resources.renderValue > completed) return false;
+        // The render timeline says nothing about presentation, which may still read the old images
+        if (resources.swapchain != nullptr && (resources.presentedValue == 0 || resources.presentedValue > completed)) {
+            return false;
+        }
+        destroyRetiredResources(resources);
+        return true;
+    });
+}
+
+void VulkanSwapchain::onImagePresented(uint32_t imageIndex, uint64_t renderValue) {
+    // Presentation is in order. Re-acquiring an image that was presented before means every earlier present,
+    // including those of retired swapchains, has released its image. This frame waited for that acquire.
+    if (isImagePresented[imageIndex]) {
+        for (auto &resources: retiredResources) {
+            if (resources.presentedValue == 0) resources.presentedValue = renderValue;
+        }
+    }
+    isImagePresented[imageIndex] = true;
+}
+
+bool VulkanSwapchain::createSwapchain(VkSwapchainKHR oldSwapchain) {
     INF "Creating VulkanSwapchain" ENDL;
 
     VulkanSwapchain::SwapchainSupportDetails swapchainSupport = VulkanSwapchain::querySwapchainSupport(
@@ -219,7 +298,7 @@ bool VulkanSwapchain::createSwapchain() {
     // Clip pixels if obscured by other window -> Perf+
     createInfo.clipped = VK_TRUE;
 
-    createInfo.oldSwapchain = nullptr; // Put previous swapchain here if overridden, e.g. if window size changed
+    createInfo.oldSwapchain = oldSwapchain; // Previous swapchain if recreated, e.g. if window size changed
 
     if (vkCreateSwapchainKHR(VulkanDevices::logical, &createInfo, nullptr, &VulkanSwapchain::swapchain) != VK_SUCCESS) {
         THROW("Failed to create swapchain!");
@@ -230,13 +309,29 @@ bool VulkanSwapchain::createSwapchain() {
     VulkanSwapchain::images.resize(VulkanSwapchain::imageCount);
     vkGetSwapchainImagesKHR(VulkanDevices::logical, VulkanSwapchain::swapchain, &VulkanSwapchain::imageCount,
                             VulkanSwapchain::images.data());
+    isImagePresented.assign(VulkanSwapchain::imageCount, false);
+    const VkFormat previousFormat = VulkanSwapchain::imageFormat;
     VulkanSwapchain::imageFormat = surfaceFormat.format;
     VulkanSwapchain::extent = extentTemp;
     VulkanSwapchain::presentMode = presentModeTemp;
 
     VulkanSwapchain::createImageViews();
     VulkanSwapchain::createDepthResources();
-    VulkanRenderPasses::create();
+
+    // The render pass only depends on the formats, so resizing keeps it.
+    // A new format, e.g. after moving to an HDR monitor, needs a new one.
+    if (VulkanRenderPasses::renderPass != nullptr && previousFormat != VulkanSwapchain::imageFormat) {
+        DBG "Swapchain format changed, recreating the render pass" ENDL;
+        retiredResources.push_back({
+                                           .renderValue = VulkanTimeline::render.lastSubmittedValue,
+                                           .renderPass = VulkanRenderPasses::renderPass
+                                   });
+        VulkanRenderPasses::renderPass = nullptr;
+        VulkanSwapchain::hasNewRenderPass = true;
+    }
+    if (VulkanRenderPasses::renderPass == nullptr) {
+        VulkanRenderPasses::create();
+    }
     createFramebuffers();
 
     return true;
@@ -245,6 +340,11 @@ bool VulkanSwapchain::createSwapchain() {
 void VulkanSwapchain::destroySwapchain() {
     INF "Destroying VulkanSwapchain" ENDL;
 
+    for (const auto &resources: retiredResources) {
+        destroyRetiredResources(resources);
+    }
+    retiredResources.clear();
+
     for (auto &swapchainFramebuffer: VulkanSwapchain::framebuffers) {
         vkDestroyFramebuffer(VulkanDevices::logical, swapchainFramebuffer, nullptr);
     }
@@ -0,0 +1,74 @@
+//
+// Created by Saman on 14.09.23.
+//
+
+#include "graphics/vulkan/vulkan_timeline.h"
+#include "graphics/vulkan/vulkan_devices.h"
+#include "io/printer.h"
+
+// Global
+VulkanTimeline::Timeline VulkanTimeline::upload{};
+VulkanTimeline::Timeline VulkanTimeline::render{};
+
+uint64_t VulkanTimeline::Timeline::next() {
+    return ++this->lastSubmittedValue;
+}
+
+void VulkanTimeline::create() {
+    INF "Creating VulkanTimeline" ENDL;
+
+    VulkanTimeline::upload = {.semaphore = createTimelineSemaphore()};
+    VulkanTimeline::render = {.semaphore = createTimelineSemaphore()};
+}
+
+void VulkanTimeline::destroy() {
+    INF "Destroying VulkanTimeline" ENDL;
+
+    vkDestroySemaphore(VulkanDevices::logical, VulkanTimeline::upload.semaphore, nullptr);
+    vkDestroySemaphore(VulkanDevices::logical, VulkanTimeline::render.semaphore, nullptr);
+    VulkanTimeline::upload = {};
+    VulkanTimeline::render = {};
+}
+
+VkSemaphore VulkanTimeline::createTimelineSemaphore(uint64_t initialValue) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initialValue;
+
+    VkSemaphoreCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.pNext = &typeInfo;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(VulkanDevices::logical, &createInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        THROW("Failed to create timeline semaphore!");
+    }
+
+    return semaphore;
+}
+
+uint64_t VulkanTimeline::completedValue(const Timeline &timeline) {
+    uint64_t value = 0;
+    VkResult result = vkGetSemaphoreCounterValue(VulkanDevices::logical, timeline.semaphore, &value);
+    if (result == VK_ERROR_DEVICE_LOST) {
+        THROW("Device lost when checking timeline semaphore");
+    }
+    return value;
+}
+
+bool VulkanTimeline::isReached(const Timeline &timeline, uint64_t value) {
+    return completedValue(timeline) >= value;
+}
+
+void VulkanTimeline::wait(const Timeline &timeline, uint64_t value, uint64_t timeout) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline.semaphore;
+    waitInfo.pValues = &value;
+
+    if (vkWaitSemaphores(VulkanDevices::logical, &waitInfo, timeout) != VK_SUCCESS) {
+        THROW("Waiting for the timeline semaphore was unsuccessful");
+    }
+}
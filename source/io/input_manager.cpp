@@ -30,16 +30,13 @@ void InputController::update(sec delta, ECS &ecs) {
 
     glfwPollEvents();
 
-    auto entities = ecs.requestEntities(InputController::EvaluatorInputManagerEntity);
-
-    for (auto e: entities) {
-        auto &state = *e->inputState;
+    ecs.forEach<InputState>(InputController::QueryInputManagerEntity, [&](const EntityHandle &, InputState &state) {
         state.closeWindow = this->closeWindow;
         state.toggleFullscreen = this->toggleFullscreen;
         state.moveForward = this->moveForward;
         state.moveBackward = this->moveBackward;
         state.toggleRotation = this->toggleRotation;
-    }
+    });
 }
 
 void InputController::_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -1,14 +1,44 @@
 
 #include "application.h"
 #include "io/printer.h"
+#include "util/importer.h"
+#include "util/thread_pool.h"
 
 #include <iostream>
 #include <sstream>
+#include <cstring>
+
+// Imports the given models and writes their mesh caches, including the LOD chain, without opening a window
+int buildCaches(int count, char **models) {
+    ThreadPool::create();
+    try {
+        for (int i = 0; i < count; ++i) {
+            std::cout << "Building mesh cache for " << models[i] << std::endl;
+            Importinator::importMesh(models[i]);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        ThreadPool::destroy();
+        return EXIT_FAILURE;
+    }
+    ThreadPool::destroy();
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--build-cache") == 0) {
+        return buildCaches(argc - 2, argv + 2);
+    }
 
-int main() {
     Application app{};
     app.title = "Hello World!";
 
+    // e.g. --mesh icosphere:1000 for 20M triangles in place of the dense sphere.
+    // Larger meshes are rejected once they exceed the shared mesh buffers, at about 11M vertices.
+    if (argc > 2 && strcmp(argv[1], "--mesh") == 0) {
+        app.generatedMeshSpec = argv[2];
+    }
+
     try {
         app.run();
     } catch (const std::exception &e) {
@@ -17,4 +47,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,416 @@
+//
+// Created by Saman on 19.09.23.
+//
+
+#include "util/gltf_loader.h"
+#include "util/mapped_file.h"
+#include "util/json.h"
+#include "util/thread_pool.h"
+#include "io/printer.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+using namespace GltfLoader;
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_VERSION = 2;
+constexpr uint32_t CHUNK_JSON = 0x4E4F534A;
+constexpr uint32_t CHUNK_BIN = 0x004E4942;
+
+constexpr uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+constexpr uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+constexpr uint32_t COMPONENT_UNSIGNED_INT = 5125;
+constexpr uint32_t COMPONENT_FLOAT = 5126;
+
+constexpr uint32_t MODE_TRIANGLES = 4;
+
+struct Document {
+    Json::Value json{};
+    const std::byte *bin = nullptr;
+    size_t binSize = 0;
+};
+
+struct Primitive {
+    const Json::Value *json = nullptr;
+    glm::mat4 transform{1.0f};
+};
+
+uint32_t readU32(const std::byte *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Element of a top level array like "accessors" or "bufferViews"
+const Json::Value *getElement(const Json::Value &root, const char *array, double index) {
+    const Json::Value *elements = root.find(array);
+    if (elements == nullptr || elements->type != Json::Type::ARRAY || index < 0 ||
+        index >= static_cast<double>(elements->array.size())) {
+        return nullptr;
+    }
+    return &elements->array[static_cast<size_t>(index)];
+}
+
+template<typename T>
+bool getAccessor(const Document &document, const Json::Value *indexValue, uint32_t componentType,
+                 const char *type, AccessorView<T> &out) {
+    if (indexValue == nullptr || !indexValue->isNumber()) return false;
+
+    const Json::Value *accessor = getElement(document.json, "accessors", indexValue->number);
+    if (accessor == nullptr || accessor->find("sparse") != nullptr) return false;
+
+    const Json::Value *accessorType = accessor->find("type");
+    if (accessor->numberOr("componentType", 0) != componentType ||
+        accessorType == nullptr || accessorType->string != type ||
+        (accessor->find("normalized") != nullptr && accessor->find("normalized")->boolean)) {
+        return false;
+    }
+
+    const Json::Value *view = getElement(document.json, "bufferViews", accessor->numberOr("bufferView", -1));
+    if (view == nullptr || view->numberOr("buffer", -1) != 0) return false;
+
+    const auto viewOffset = static_cast<size_t>(view->numberOr("byteOffset", 0));
+    const auto viewLength = static_cast<size_t>(view->numberOr("byteLength", 0));
+    const auto accessorOffset = static_cast<size_t>(accessor->numberOr("byteOffset", 0));
+    const auto count = static_cast<size_t>(accessor->numberOr("count", 0));
+    const auto stride = static_cast<size_t>(view->numberOr("byteStride", sizeof(T)));
+
+    if (viewOffset + viewLength > document.binSize) return false;
+    if (count > 0 && accessorOffset + (count - 1) * stride + sizeof(T) > viewLength) return false;
+
+    out.data = document.bin + viewOffset + accessorOffset;
+    out.count = count;
+    out.stride = stride;
+    return true;
+}
+
+glm::mat4 getLocalTransform(const Json::Value &node) {
+    const Json::Value *matrix = node.find("matrix");
+    if (matrix != nullptr && matrix->array.size() == 16) {
+        glm::mat4 out{};
+        for (uint32_t i = 0; i < 16; ++i) {
+            out[i / 4][i % 4] = static_cast<float>(matrix->array[i].number); // Column major, like glm
+        }
+        return out;
+    }
+
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+    if (const Json::Value *t = node.find("translation"); t != nullptr && t->array.size() == 3) {
+        translation = {t->array[0].number, t->array[1].number, t->array[2].number};
+    }
+    if (const Json::Value *r = node.find("rotation"); r != nullptr && r->array.size() == 4) {
+        // glTF stores x, y, z, w
+        rotation = glm::quat(static_cast<float>(r->array[3].number), static_cast<float>(r->array[0].number),
+                             static_cast<float>(r->array[1].number), static_cast<float>(r->array[2].number));
+    }
+    if (const Json::Value *s = node.find("scale"); s != nullptr && s->array.size() == 3) {
+        scale = {s->array[0].number, s->array[1].number, s->array[2].number};
+    }
+
+    glm::mat4 out = glm::mat4_cast(rotation);
+    out[0] *= scale.x;
+    out[1] *= scale.y;
+    out[2] *= scale.z;
+    out[3] = glm::vec4(translation, 1.0f);
+    return out;
+}
+
+bool collectPrimitives(const Document &document, double nodeIndex, const glm::mat4 &parentTransform,
+                       uint32_t depth, std::vector<Primitive> &out) {
+    const Json::Value *node = getElement(document.json, "nodes", nodeIndex);
+    const Json::Value *nodes = document.json.find("nodes");
+    if (node == nullptr || depth > nodes->array.size()) return false; // Deeper than the node count means a cycle
+
+    const glm::mat4 transform = parentTransform * getLocalTransform(*node);
+
+    if (const Json::Value *meshIndex = node->find("mesh"); meshIndex != nullptr) {
+        const Json::Value *mesh = getElement(document.json, "meshes", meshIndex->number);
+        const Json::Value *primitives = mesh != nullptr ? mesh->find("primitives") : nullptr;
+        if (primitives == nullptr) return false;
+        for (const auto &primitive: primitives->array) {
+            out.push_back({&primitive, transform});
+        }
+    }
+
+    if (const Json::Value *children = node->find("children"); children != nullptr) {
+        for (const auto &child: children->array) {
+            if (!collectPrimitives(document, child.number, transform, depth + 1, out)) return false;
+        }
+    }
+    return true;
+}
+
+bool collectPrimitives(const Document &document, std::vector<Primitive> &out) {
+    const Json::Value *scene = getElement(document.json, "scenes", document.json.numberOr("scene", 0));
+    const Json::Value *roots = scene != nullptr ? scene->find("nodes") : nullptr;
+
+    if (roots == nullptr) {
+        // No scene graph, take all meshes untransformed
+        const Json::Value *meshes = document.json.find("meshes");
+        if (meshes == nullptr) return false;
+        for (const auto &mesh: meshes->array) {
+            const Json::Value *primitives = mesh.find("primitives");
+            if (primitives == nullptr) return false;
+            for (const auto &primitive: primitives->array) {
+                out.push_back({&primitive, glm::mat4{1.0f}});
+            }
+        }
+        return true;
+    }
+
+    for (const auto &root: roots->array) {
+        if (!collectPrimitives(document, root.number, glm::mat4{1.0f}, 0, out)) return false;
+    }
+    return true;
+}
+
+// Returns false if an index is outside the primitive's own vertices
+template<typename T>
+bool copyIndices(const AccessorView<T> &view, size_t vertexCount, uint32_t baseVertex, uint32_t *out) {
+    if constexpr (std::is_same_v<T, uint32_t>) {
+        if (baseVertex == 0 && view.isTightlyPacked()) {
+            memcpy(out, view.data, view.count * sizeof(uint32_t));
+            return std::all_of(out, out + view.count, [&](uint32_t index) { return index < vertexCount; });
+        }
+    }
+    for (size_t i = 0; i < view.count; ++i) {
+        const T index = view[i];
+        if (index >= vertexCount) return false;
+        out[i] = static_cast<uint32_t>(index) + baseVertex;
+    }
+    return true;
+}
+
+struct PrimitiveViews {
+    AccessorView<glm::vec3> positions{};
+    AccessorView<glm::vec3> normals{};
+    AccessorView<glm::vec4> tangents{};
+    AccessorView<glm::vec2> uvs{};
+    bool hasNormals = false;
+    bool hasTangents = false;
+    bool hasUvs = false;
+
+    uint32_t indexType = 0; // 0 if not indexed
+    AccessorView<uint8_t> indices8{};
+    AccessorView<uint16_t> indices16{};
+    AccessorView<uint32_t> indices32{};
+
+    [[nodiscard]] size_t indexCount() const {
+        switch (indexType) {
+            case COMPONENT_UNSIGNED_BYTE:
+                return indices8.count;
+            case COMPONENT_UNSIGNED_SHORT:
+                return indices16.count;
+            case COMPONENT_UNSIGNED_INT:
+                return indices32.count;
+            default:
+                return positions.count;
+        }
+    }
+};
+
+bool getPrimitiveViews(const Document &document, const Json::Value &primitive, PrimitiveViews &out) {
+    if (primitive.numberOr("mode", MODE_TRIANGLES) != MODE_TRIANGLES) return false;
+
+    const Json::Value *attributes = primitive.find("attributes");
+    if (attributes == nullptr) return false;
+
+    if (!getAccessor(document, attributes->find("POSITION"), COMPONENT_FLOAT, "VEC3", out.positions)) {
+        return false;
+    }
+
+    // Missing normals and tangents are generated in MeshProcessing
+    if (attributes->find("NORMAL") != nullptr) {
+        if (!getAccessor(document, attributes->find("NORMAL"), COMPONENT_FLOAT, "VEC3", out.normals) ||
+            out.normals.count != out.positions.count) {
+            return false;
+        }
+        out.hasNormals = true;
+    }
+
+    if (attributes->find("TANGENT") != nullptr) {
+        if (!getAccessor(document, attributes->find("TANGENT"), COMPONENT_FLOAT, "VEC4", out.tangents) ||
+            out.tangents.count != out.positions.count) {
+            return false;
+        }
+        out.hasTangents = true;
+    }
+
+    if (attributes->find("TEXCOORD_0") != nullptr) {
+        if (!getAccessor(document, attributes->find("TEXCOORD_0"), COMPONENT_FLOAT, "VEC2", out.uvs) ||
+            out.uvs.count != out.positions.count) {
+            return false;
+        }
+        out.hasUvs = true;
+    }
+
+    const Json::Value *indices = primitive.find("indices");
+    if (indices == nullptr) {
+        return out.positions.count % 3 == 0;
+    }
+
+    const Json::Value *accessor = getElement(document.json, "accessors", indices->number);
+    if (accessor == nullptr) return false;
+    out.indexType = static_cast<uint32_t>(accessor->numberOr("componentType", 0));
+    bool isValid;
+    switch (out.indexType) {
+        case COMPONENT_UNSIGNED_BYTE:
+            isValid = getAccessor(document, indices, out.indexType, "SCALAR", out.indices8);
+            break;
+        case COMPONENT_UNSIGNED_SHORT:
+            isValid = getAccessor(document, indices, out.indexType, "SCALAR", out.indices16);
+            break;
+        case COMPONENT_UNSIGNED_INT:
+            isValid = getAccessor(document, indices, out.indexType, "SCALAR", out.indices32);
+            break;
+        default:
+            return false;
+    }
+    // Partial triangles would shift every following triangle of the mesh
+    return isValid && out.indexCount() % 3 == 0;
+}
+
+// Returns false if the primitive's indices are out of range
+bool copyPrimitive(const PrimitiveViews &views, const glm::mat4 &transform, uint32_t baseVertex,
+                   Vertex *vertices, uint32_t *indices) {
+    const bool isIdentity = transform == glm::mat4{1.0f};
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+    for (size_t i = 0; i < views.positions.count; ++i) {
+        Vertex &vertex = vertices[i];
+        vertex.pos = views.positions[i];
+        if (!isIdentity) {
+            vertex.pos = glm::vec3(transform * glm::vec4(vertex.pos, 1.0f));
+        }
+
+        if (views.hasNormals) {
+            vertex.normal = isIdentity ? views.normals[i] : glm::normalize(normalMatrix * views.normals[i]);
+        }
+
+        if (views.hasTangents) {
+            const glm::vec4 tangent = views.tangents[i];
+            vertex.tangent = isIdentity ? glm::vec3(tangent) : glm::normalize(glm::mat3(transform) * glm::vec3(tangent));
+            // The w component holds the handedness of the bitangent
+            vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * tangent.w;
+        }
+
+        if (views.hasUvs) {
+            vertex.uvw = glm::vec3(views.uvs[i], 0.0f);
+        }
+    }
+
+    switch (views.indexType) {
+        case COMPONENT_UNSIGNED_BYTE:
+            return copyIndices(views.indices8, views.positions.count, baseVertex, indices);
+        case COMPONENT_UNSIGNED_SHORT:
+            return copyIndices(views.indices16, views.positions.count, baseVertex, indices);
+        case COMPONENT_UNSIGNED_INT:
+            return copyIndices(views.indices32, views.positions.count, baseVertex, indices);
+        default:
+            for (uint32_t i = 0; i < views.positions.count; ++i) {
+                indices[i] = baseVertex + i;
+            }
+            return true;
+    }
+}
+
+bool GltfLoader::loadGlb(const std::string &filename, Importinator::Mesh &out) {
+    MappedFile file{};
+    if (!file.open(filename)) return false;
+
+    // 12 byte file header, followed by the JSON chunk and an optional BIN chunk, each with an 8 byte header
+    const std::byte *data = file.data();
+    if (file.size() < 20 || readU32(data) != GLB_MAGIC || readU32(data + 4) != GLB_VERSION ||
+        readU32(data + 8) > file.size()) {
+        return false;
+    }
+    const size_t fileLength = readU32(data + 8);
+
+    const size_t jsonLength = readU32(data + 12);
+    if (readU32(data + 16) != CHUNK_JSON || 20 + jsonLength > fileLength) return false;
+
+    auto json = Json::parse(std::string_view(reinterpret_cast<const char *>(data + 20), jsonLength));
+    if (!json.has_value()) {
+        DBG "Invalid glTF JSON in " << filename ENDL;
+        return false;
+    }
+
+    Document document{};
+    document.json = std::move(*json);
+
+    const size_t binHeader = 20 + ((jsonLength + 3) & ~size_t{3});
+    if (binHeader + 8 <= fileLength && readU32(data + binHeader + 4) == CHUNK_BIN) {
+        document.bin = data + binHeader + 8;
+        document.binSize = std::min<size_t>(readU32(data + binHeader), fileLength - binHeader - 8);
+    }
+
+    // Compression extensions and external buffers are Assimp's business
+    if (const Json::Value *required = document.json.find("extensionsRequired");
+            required != nullptr && !required->array.empty()) {
+        return false;
+    }
+    const Json::Value *buffer = getElement(document.json, "buffers", 0);
+    if (buffer == nullptr || buffer->find("uri") != nullptr || getElement(document.json, "buffers", 1) != nullptr) {
+        return false;
+    }
+
+    std::vector<Primitive> primitives{};
+    if (!collectPrimitives(document, primitives) || primitives.empty()) return false;
+
+    std::vector<PrimitiveViews> views(primitives.size());
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        if (!getPrimitiveViews(document, *primitives[i].json, views[i])) {
+            DBG "Unsupported glTF primitive in " << filename ENDL;
+            return false;
+        }
+        vertexCount += views[i].positions.count;
+        indexCount += views[i].indexCount();
+        out.hasNormals &= views[i].hasNormals;
+        out.hasTangents &= views[i].hasTangents && views[i].hasNormals; // Bitangents need the normals
+    }
+
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) return false;
+
+    out.vertices.assign(vertexCount, Vertex{});
+    out.indices.resize(indexCount);
+    out.submeshes.resize(primitives.size());
+
+    uint32_t baseVertex = 0;
+    uint32_t baseIndex = 0;
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        out.submeshes[i] = {
+                .firstIndex = baseIndex,
+                .indexCount = static_cast<uint32_t>(views[i].indexCount()),
+                .firstVertex = baseVertex,
+                .vertexCount = static_cast<uint32_t>(views[i].positions.count)
+        };
+        baseVertex += out.submeshes[i].vertexCount;
+        baseIndex += out.submeshes[i].indexCount;
+    }
+
+    // Primitives write disjoint ranges. An index past its own primitive would pull in another primitive's vertices
+    // or read past the vertex buffer on the GPU.
+    std::vector<uint8_t> isValid(primitives.size());
+    ThreadPool::parallelFor(primitives.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+            isValid[i] = copyPrimitive(views[i], primitives[i].transform, out.submeshes[i].firstVertex,
+                                       out.vertices.data() + out.submeshes[i].firstVertex,
+                                       out.indices.data() + out.submeshes[i].firstIndex);
+        }
+    }, 1);
+
+    if (std::find(isValid.begin(), isValid.end(), 0) != isValid.end()) {
+        DBG "Out of range index in " << filename ENDL;
+        return false;
+    }
+
+    return true;
+}
@@ -4,11 +4,19 @@
 
 #include "util/importer.h"
 #include "io/printer.h"
+#include "util/mesh_cache.h"
+#include "util/gltf_loader.h"
+#include "util/timer.h"
+#include "util/mesh_processing.h"
+#include "util/thread_pool.h"
 
 #include <fstream>
+#include <algorithm>
+#include <cctype>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/config.h>
 
 std::vector<char> Importinator::readFile(const std::string &filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -27,16 +35,40 @@ std::vector<char> Importinator::readFile(const std::string &filename) {
     return buffer;
 }
 
-Importinator::Mesh Importinator::importMesh(const std::string &filename) {
+constexpr size_t CONVERSION_CHUNK_SIZE = 16384;
+
+// Calls function(submesh, localBegin, localEnd) for every part of [begin, end) that falls into a submesh.
+// range(submesh) returns first element and count of a submesh, in the same unit as begin and end.
+template<typename Range, typename Function>
+void forEachSubmeshPart(const std::vector<Importinator::Submesh> &submeshes, size_t begin, size_t end,
+                        Range range, Function function) {
+    // Last submesh starting at or before begin
+    auto it = std::upper_bound(submeshes.begin(), submeshes.end(), begin,
+                               [&](size_t value, const Importinator::Submesh &submesh) {
+                                   return value < range(submesh).first;
+                               });
+    size_t submesh = it == submeshes.begin() ? 0 : static_cast<size_t>(it - submeshes.begin()) - 1;
+
+    for (; submesh < submeshes.size(); ++submesh) {
+        const auto [first, count] = range(submeshes[submesh]);
+        if (first >= end) break;
+        const size_t partBegin = std::max<size_t>(begin, first);
+        const size_t partEnd = std::min<size_t>(end, first + count);
+        if (partBegin < partEnd) {
+            function(submesh, static_cast<uint32_t>(partBegin - first), static_cast<uint32_t>(partEnd - first));
+        }
+    }
+}
+
+Importinator::Mesh importWithAssimp(const std::string &filename) {
     Importinator::Mesh out{};
     Assimp::Importer importer{};
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
 
+    // Welding, normals and tangents are left to MeshProcessing, which runs in parallel
     const aiScene *scene = importer.ReadFile(filename,
-                                             aiProcess_CalcTangentSpace |
                                              aiProcess_Triangulate |
-                                             aiProcess_JoinIdenticalVertices |
                                              aiProcess_SortByPType |
-                                             aiProcess_GenNormals |
                                              aiProcess_GenUVCoords |
                                              aiProcess_OptimizeGraph |
                                              aiProcess_OptimizeMeshes |
@@ -48,48 +80,124 @@ Importinator::Mesh Importinator::importMesh(const std::string &filename) {
         DBG "Read mesh " << filename ENDL;
     }
 
+    // Points and lines were split off by SortByPType, only triangle meshes are kept
+    std::vector<const aiMesh *> meshes{};
     for (uint32_t meshIndex = 0; meshIndex < (scene->mNumMeshes); ++meshIndex) {
         const aiMesh *mesh = *(scene->mMeshes + meshIndex);
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && mesh->HasPositions()) {
+            meshes.push_back(mesh);
+        }
+    }
 
-        out.vertices.resize(out.vertices.size() + mesh->mNumVertices);
-
-        for (uint32_t i = 0; i < (mesh->mNumVertices); ++i) {
-            if (mesh->HasPositions()) {
+    // All sizes are known up front, so every submesh converts into its own range of the merged arrays.
+    // Summed in 64 bits, since the merged mesh is addressed with 32 bit indices.
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+    out.submeshes.resize(meshes.size());
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex) {
+        const aiMesh *mesh = meshes[meshIndex];
+        const uint64_t meshIndexCount = uint64_t{mesh->mNumFaces} * 3;
+        if (vertexCount + mesh->mNumVertices > UINT32_MAX || indexCount + meshIndexCount > UINT32_MAX) {
+            THROW("Too many vertices or indices in " + filename);
+        }
+        out.submeshes[meshIndex] = {
+                .firstIndex = static_cast<uint32_t>(indexCount),
+                .indexCount = static_cast<uint32_t>(meshIndexCount),
+                .firstVertex = static_cast<uint32_t>(vertexCount),
+                .vertexCount = mesh->mNumVertices
+        };
+        vertexCount += mesh->mNumVertices;
+        indexCount += meshIndexCount;
+        out.hasNormals &= mesh->HasNormals();
+        out.hasTangents &= mesh->HasTangentsAndBitangents();
+    }
+    if (meshes.empty()) {
+        THROW("No triangle meshes in " + filename);
+    }
+    out.vertices.resize(vertexCount);
+    out.indices.resize(indexCount);
+
+    // Parallel over all vertices, so a single large submesh is split up as well
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t) {
+        forEachSubmeshPart(out.submeshes, begin, end, [](const Importinator::Submesh &submesh) {
+            return std::make_pair(submesh.firstVertex, submesh.vertexCount);
+        }, [&](size_t meshIndex, uint32_t localBegin, uint32_t localEnd) {
+            const aiMesh *mesh = meshes[meshIndex];
+            Vertex *vertices = out.vertices.data() + out.submeshes[meshIndex].firstVertex;
+
+            for (uint32_t i = localBegin; i < localEnd; ++i) {
                 aiVector3D vertex = *(mesh->mVertices + i);
-                out.vertices[i].pos = glm::vec3(vertex.x, vertex.y, vertex.z);
+                vertices[i].pos = glm::vec3(vertex.x, vertex.y, vertex.z);
+
+                if (mesh->HasNormals()) {
+                    aiVector3D normal = *(mesh->mNormals + i);
+                    vertices[i].normal = glm::vec3(normal.x, normal.y, normal.z);
+                }
+
+                if (mesh->HasTangentsAndBitangents()) {
+                    aiVector3D tangent = *(mesh->mTangents + i);
+                    aiVector3D bitangent = *(mesh->mBitangents + i);
+
+                    vertices[i].tangent = glm::vec3(tangent.x, tangent.y, tangent.z);
+                    vertices[i].bitangent = glm::vec3(bitangent.x, bitangent.y, bitangent.z);
+                }
+
+                if (mesh->HasTextureCoords(0)) {
+                    // A vertex can have multiple UVs. We'll just pick the first one. TODO
+                    aiVector3D uv = *(mesh->mTextureCoords[0] + i);
+                    vertices[i].uvw = glm::vec3(uv.x, uv.y, uv.z);
+                }
             }
-
-            if (mesh->HasNormals()) {
-                aiVector3D normal = *(mesh->mNormals + i);
-                out.vertices[i].normal = glm::vec3(normal.x, normal.y, normal.z);
+        });
+    }, CONVERSION_CHUNK_SIZE);
+
+    // Face indices are local to their submesh and get rebased onto the merged vertex array
+    ThreadPool::parallelFor(indexCount / 3, [&](size_t begin, size_t end, uint32_t) {
+        forEachSubmeshPart(out.submeshes, begin, end, [](const Importinator::Submesh &submesh) {
+            return std::make_pair(submesh.firstIndex / 3, submesh.indexCount / 3);
+        }, [&](size_t meshIndex, uint32_t localBegin, uint32_t localEnd) {
+            const aiMesh *mesh = meshes[meshIndex];
+            const uint32_t baseVertex = out.submeshes[meshIndex].firstVertex;
+            uint32_t *indices = out.indices.data() + out.submeshes[meshIndex].firstIndex;
+
+            for (uint32_t i = localBegin; i < localEnd; ++i) {
+                aiFace face = *(mesh->mFaces + i);
+                indices[i * 3] = (*(face.mIndices)) + baseVertex;
+                indices[i * 3 + 1] = (*(face.mIndices + 1)) + baseVertex;
+                indices[i * 3 + 2] = (*(face.mIndices + 2)) + baseVertex;
             }
+        });
+    }, CONVERSION_CHUNK_SIZE);
 
-            if (mesh->HasTangentsAndBitangents()) {
-                aiVector3D tangent = *(mesh->mTangents + i);
-                aiVector3D bitangent = *(mesh->mBitangents + i);
-
-                out.vertices[i].tangent = glm::vec3(tangent.x, tangent.y, tangent.z);
-                out.vertices[i].bitangent = glm::vec3(bitangent.x, bitangent.y, bitangent.z);
-            }
+    return out;
+}
 
-            if (mesh->HasTextureCoords(0)) {
-                // A vertex can have multiple UVs. We'll just pick the first one. TODO
-                aiVector3D uv = *(mesh->mTextureCoords[0] + i);
-                out.vertices[i].uvw = glm::vec3(uv.x, uv.y, uv.z);
-            }
-        }
+bool isGlb(const std::string &filename) {
+    if (filename.size() < 4) return false;
+    std::string extension = filename.substr(filename.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".glb";
+}
 
-        out.indices.resize(out.indices.size() + (mesh->mNumFaces * 3));
+Importinator::Mesh Importinator::importMesh(const std::string &filename, uint32_t postProcessing) {
+    Importinator::Mesh out{};
+    if (MeshCache::load(filename, postProcessing, out)) {
+        return out;
+    }
 
-        for (uint32_t i = 0; i < (mesh->mNumFaces); ++i) {
-            aiFace face = *(mesh->mFaces + i);
-            out.indices[i * 3] = (*(face.mIndices));
-            out.indices[i * 3 + 1] = (*(face.mIndices + 1));
-            out.indices[i * 3 + 2] = (*(face.mIndices + 2));
-        }
+    const auto startTime = Timer::now();
+    if (isGlb(filename) && GltfLoader::loadGlb(filename, out)) {
+        DBG "Read mesh " << filename << " natively" ENDL;
+    } else {
+        out = importWithAssimp(filename);
     }
+    DBG "\tImport took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+
+    MeshProcessing::process(out, postProcessing);
     DBG "\tIndices: " << out.indices.size() ENDL;
     DBG "\tVertices: " << out.vertices.size() ENDL;
 
+    MeshCache::store(filename, postProcessing, out);
+
     return out;
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+//
+// Created by Saman on 19.09.23.
+//
+
+#include "util/json.h"
+
+#include <cstdlib>
+
+const Json::Value *Json::Value::find(std::string_view key) const {
+    if (type != Type::OBJECT) return nullptr;
+    for (const auto &member: object) {
+        if (member.first == key) return &member.second;
+    }
+    return nullptr;
+}
+
+double Json::Value::numberOr(std::string_view key, double fallback) const {
+    const Value *value = find(key);
+    return value != nullptr && value->isNumber() ? value->number : fallback;
+}
+
+// Recursive descent over the input, failing on the first unexpected character
+class Parser {
+public:
+    explicit Parser(std::string_view text) : text(text) {}
+
+    bool parseValue(Json::Value &out, uint32_t depth = 0) {
+        if (depth > MAX_DEPTH) return false;
+        skipWhitespace();
+        if (position >= text.size()) return false;
+
+        switch (text[position]) {
+            case '{':
+                return parseObject(out, depth);
+            case '[':
+                return parseArray(out, depth);
+            case '"':
+                out.type = Json::Type::STRING;
+                return parseString(out.string);
+            case 't':
+                out.type = Json::Type::BOOLEAN;
+                out.boolean = true;
+                return consumeLiteral("true");
+            case 'f':
+                out.type = Json::Type::BOOLEAN;
+                out.boolean = false;
+                return consumeLiteral("false");
+            case 'n':
+                out.type = Json::Type::NUL;
+                return consumeLiteral("null");
+            default:
+                return parseNumber(out);
+        }
+    }
+
+    bool isAtEnd() {
+        skipWhitespace();
+        return position == text.size();
+    }
+
+private:
+    static constexpr uint32_t MAX_DEPTH = 256;
+
+    void skipWhitespace() {
+        while (position < text.size() &&
+               (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+            ++position;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (position < text.size() && text[position] == c) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeLiteral(std::string_view literal) {
+        if (text.substr(position, literal.size()) != literal) return false;
+        position += literal.size();
+        return true;
+    }
+
+    bool parseObject(Json::Value &out, uint32_t depth) {
+        out.type = Json::Type::OBJECT;
+        ++position; // {
+        if (consume('}')) return true;
+
+        do {
+            skipWhitespace();
+            std::string key{};
+            if (!parseString(key) || !consume(':')) return false;
+            out.object.emplace_back(std::move(key), Json::Value{});
+            if (!parseValue(out.object.back().second, depth + 1)) return false;
+        } while (consume(','));
+
+        return consume('}');
+    }
+
+    bool parseArray(Json::Value &out, uint32_t depth) {
+        out.type = Json::Type::ARRAY;
+        ++position; // [
+        if (consume(']')) return true;
+
+        do {
+            out.array.emplace_back();
+            if (!parseValue(out.array.back(), depth + 1)) return false;
+        } while (consume(','));
+
+        return consume(']');
+    }
+
+    bool parseString(std::string &out) {
+        if (position >= text.size() || text[position] != '"') return false;
+        ++position;
+
+        while (position < text.size()) {
+            char c = text[position++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+
+            if (position >= text.size()) return false;
+            c = text[position++];
+            switch (c) {
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u': {
+                    // glTF keys are plain ASCII. Anything else is kept as UTF-8, without surrogate pair handling.
+                    if (position + 4 > text.size()) return false;
+                    const std::string hex{text.substr(position, 4)};
+                    char *end = nullptr;
+                    const auto codePoint = static_cast<uint32_t>(std::strtoul(hex.c_str(), &end, 16));
+                    if (end != hex.c_str() + 4) return false;
+                    position += 4;
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+                default:
+                    out.push_back(c); // \" \\ \/
+                    break;
+            }
+        }
+        return false;
+    }
+
+    static void appendUtf8(std::string &out, uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            out.push_back(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    bool parseNumber(Json::Value &out) {
+        const size_t start = position;
+        while (position < text.size()) {
+            const char c = text[position];
+            if ((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') break;
+            ++position;
+        }
+        if (position == start) return false;
+
+        const std::string number{text.substr(start, position - start)};
+        char *end = nullptr;
+        out.type = Json::Type::NUMBER;
+        out.number = std::strtod(number.c_str(), &end);
+        return end == number.c_str() + number.size();
+    }
+
+    std::string_view text;
+    size_t position = 0;
+};
+
+std::optional<Json::Value> Json::parse(std::string_view text) {
+    Parser parser{text};
+    Json::Value root{};
+    if (!parser.parseValue(root) || !parser.isAtEnd()) {
+        return std::nullopt;
+    }
+    return root;
+}
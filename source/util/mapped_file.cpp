@@ -0,0 +1,120 @@
+//
+// Created by Saman on 18.09.23.
+//
+
+#include "util/mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        close();
+        this->mappedData = std::exchange(other.mappedData, nullptr);
+        this->mappedSize = std::exchange(other.mappedSize, 0);
+#ifdef _WIN32
+        this->fileHandle = std::exchange(other.fileHandle, nullptr);
+        this->mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filename) {
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    this->fileHandle = file;
+    this->mappingHandle = mapping;
+    this->mappedData = static_cast<const std::byte *>(view);
+    this->mappedSize = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->mappedData != nullptr) UnmapViewOfFile(this->mappedData);
+    if (this->mappingHandle != nullptr) CloseHandle(this->mappingHandle);
+    if (this->fileHandle != nullptr) CloseHandle(this->fileHandle);
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+    this->mappingHandle = nullptr;
+    this->fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filename) {
+    close();
+
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat fileStat{};
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(file);
+        return false;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED) return false;
+
+    // The whole file is read front to back
+    madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+    this->mappedData = static_cast<const std::byte *>(view);
+    this->mappedSize = static_cast<size_t>(fileStat.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->mappedData != nullptr) {
+        munmap(const_cast<std::byte *>(this->mappedData), this->mappedSize);
+    }
+    this->mappedData = nullptr;
+    this->mappedSize = 0;
+}
+
+#endif
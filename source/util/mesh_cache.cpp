@@ -0,0 +1,314 @@
+//
+// Created by Saman on 18.09.23.
+//
+
+#include "util/mesh_cache.h"
+#include "util/mapped_file.h"
+#include "util/timer.h"
+#include "io/printer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <array>
+#include <algorithm>
+
+extern const uint32_t MeshCache::VERSION = 7;
+
+constexpr uint32_t MAGIC = 0x434d4352; // "RCMC"
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexSize; // sizeof(Vertex) when written
+    uint32_t postProcessing; // Importinator::PostProcessing steps applied
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t submeshCount;
+    uint64_t lodCount;
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    uint64_t checksum; // Over the whole payload
+    float boundsMin[3]; // Axis aligned bounding box, readable without touching the payload
+    float boundsMax[3];
+};
+
+struct LodHeader {
+    float cellSize;
+    uint32_t reserved;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+};
+
+// Payload: vertices, indices, submeshes, LOD headers, then vertices and indices of every LOD
+
+// Bounds checked sequential reads from the payload
+class PayloadReader {
+public:
+    PayloadReader(const std::byte *data, size_t size) : data(data), remaining(size) {}
+
+    template<typename T>
+    bool read(std::vector<T> &out, uint64_t count) {
+        if (count > remaining / sizeof(T)) return false;
+        const size_t bytes = count * sizeof(T);
+        out.resize(count);
+        if (bytes > 0) memcpy(out.data(), data, bytes);
+        data += bytes;
+        remaining -= bytes;
+        return true;
+    }
+
+    [[nodiscard]] bool isAtEnd() const { return remaining == 0; }
+
+private:
+    const std::byte *data;
+    size_t remaining;
+};
+
+// XXH64 with seed 0, streamed. Four independent lanes over 32 byte stripes, so the multiplications overlap
+// and warm loads stay limited by memory bandwidth. https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+class PayloadHash {
+public:
+    void update(const std::byte *data, size_t size) {
+        this->totalSize += size;
+        if (this->buffered > 0) {
+            const size_t count = std::min(size, STRIPE_SIZE - this->buffered);
+            memcpy(this->buffer.data() + this->buffered, data, count);
+            this->buffered += count;
+            data += count;
+            size -= count;
+            if (this->buffered < STRIPE_SIZE) return;
+            consumeStripe(this->buffer.data());
+            this->buffered = 0;
+        }
+        for (; size >= STRIPE_SIZE; data += STRIPE_SIZE, size -= STRIPE_SIZE) {
+            consumeStripe(data);
+        }
+        if (size > 0) memcpy(this->buffer.data(), data, size);
+        this->buffered = size;
+    }
+
+    [[nodiscard]] uint64_t finish() const {
+        uint64_t hash;
+        if (this->totalSize >= STRIPE_SIZE) {
+            hash = rotl(this->lanes[0], 1) + rotl(this->lanes[1], 7) + rotl(this->lanes[2], 12) +
+                   rotl(this->lanes[3], 18);
+            for (const uint64_t lane: this->lanes) {
+                hash = (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+            }
+        } else {
+            hash = PRIME5;
+        }
+        hash += this->totalSize;
+
+        size_t i = 0;
+        for (; i + 8 <= this->buffered; i += 8) {
+            hash = rotl(hash ^ round(0, load<uint64_t>(this->buffer.data() + i)), 27) * PRIME1 + PRIME4;
+        }
+        if (i + 4 <= this->buffered) {
+            hash = rotl(hash ^ (load<uint32_t>(this->buffer.data() + i) * PRIME1), 23) * PRIME2 + PRIME3;
+            i += 4;
+        }
+        for (; i < this->buffered; ++i) {
+            hash = rotl(hash ^ (static_cast<uint64_t>(this->buffer[i]) * PRIME5), 11) * PRIME1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+private:
+    static constexpr size_t STRIPE_SIZE = 32;
+    static constexpr uint64_t PRIME1 = 0x9e3779b185ebca87ull;
+    static constexpr uint64_t PRIME2 = 0xc2b2ae3d27d4eb4full;
+    static constexpr uint64_t PRIME3 = 0x165667b19e3779f9ull;
+    static constexpr uint64_t PRIME4 = 0x85ebca77c2b2ae63ull;
+    static constexpr uint64_t PRIME5 = 0x27d4eb2f165667c5ull;
+
+    static uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static uint64_t round(uint64_t accumulator, uint64_t input) {
+        return rotl(accumulator + input * PRIME2, 31) * PRIME1;
+    }
+
+    // Unaligned, in the machine's byte order. Caches are not shared between machines.
+    template<typename T>
+    static uint64_t load(const std::byte *data) {
+        T value;
+        memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    void consumeStripe(const std::byte *stripe) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+            this->lanes[lane] = round(this->lanes[lane], load<uint64_t>(stripe + lane * 8));
+        }
+    }
+
+    std::array<uint64_t, 4> lanes{PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+    std::array<std::byte, STRIPE_SIZE> buffer{};
+    size_t buffered = 0;
+    uint64_t totalSize = 0;
+};
+
+// Identifies the version of the source file the cache was built from
+bool describeSource(const std::string &sourceFile, uint64_t &size, int64_t &modifiedTime) {
+    std::error_code error;
+    size = std::filesystem::file_size(sourceFile, error);
+    if (error) return false;
+    modifiedTime = std::filesystem::last_write_time(sourceFile, error).time_since_epoch().count();
+    return !error;
+}
+
+std::string MeshCache::getCachePath(const std::string &sourceFile) {
+    return sourceFile + ".meshcache";
+}
+
+// Opens the cache and checks that its header matches the source file and settings
+bool openCache(const std::string &sourceFile, uint32_t postProcessing, MappedFile &file, CacheHeader &header) {
+    if (!file.open(MeshCache::getCachePath(sourceFile))) {
+        DBG "No mesh cache for " << sourceFile ENDL;
+        return false;
+    }
+
+    if (file.size() < sizeof(header)) return false;
+    memcpy(&header, file.data(), sizeof(header));
+
+    uint64_t sourceSize;
+    int64_t sourceModifiedTime;
+    if (!describeSource(sourceFile, sourceSize, sourceModifiedTime) ||
+        header.magic != MAGIC || header.version != MeshCache::VERSION || header.vertexSize != sizeof(Vertex) ||
+        header.postProcessing != postProcessing ||
+        header.sourceSize != sourceSize || header.sourceModifiedTime != sourceModifiedTime) {
+        DBG "Mesh cache for " << sourceFile << " is outdated" ENDL;
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::loadBounds(const std::string &sourceFile, uint32_t postProcessing, glm::vec3 &min, glm::vec3 &max) {
+    MappedFile file{};
+    CacheHeader header{};
+    if (!openCache(sourceFile, postProcessing, file, header)) return false;
+
+    min = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+    max = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+    return true;
+}
+
+bool MeshCache::load(const std::string &sourceFile, uint32_t postProcessing, Importinator::Mesh &out) {
+    const auto startTime = Timer::now();
+
+    MappedFile file{};
+    CacheHeader header{};
+    if (!openCache(sourceFile, postProcessing, file, header)) return false;
+
+    const std::byte *payload = file.data() + sizeof(header);
+    const size_t payloadSize = file.size() - sizeof(header);
+    PayloadHash hash{};
+    hash.update(payload, payloadSize);
+    if (hash.finish() != header.checksum) {
+        DBG "Mesh cache for " << sourceFile << " is corrupted" ENDL;
+        return false;
+    }
+
+    // One bulk copy per array, straight from the page cache
+    PayloadReader reader{payload, payloadSize};
+    Importinator::Mesh mesh{};
+    std::vector<LodHeader> lodHeaders{};
+    bool isValid = reader.read(mesh.vertices, header.vertexCount) &&
+                   reader.read(mesh.indices, header.indexCount) &&
+                   reader.read(mesh.submeshes, header.submeshCount) &&
+                   reader.read(lodHeaders, header.lodCount);
+    mesh.boundsMin = {header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]};
+    mesh.boundsMax = {header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]};
+    mesh.lods.resize(lodHeaders.size());
+    for (size_t i = 0; isValid && i < lodHeaders.size(); ++i) {
+        mesh.lods[i].cellSize = lodHeaders[i].cellSize;
+        isValid = reader.read(mesh.lods[i].vertices, lodHeaders[i].vertexCount) &&
+                  reader.read(mesh.lods[i].indices, lodHeaders[i].indexCount);
+    }
+    if (!isValid || !reader.isAtEnd()) {
+        DBG "Mesh cache for " << sourceFile << " has the wrong size" ENDL;
+        return false;
+    }
+    out = std::move(mesh);
+
+    DBG "Loaded mesh cache for " << sourceFile << " in " << Timer::duration(startTime, Timer::now()) << " seconds"
+        ENDL;
+    return true;
+}
+
+void MeshCache::store(const std::string &sourceFile, uint32_t postProcessing, const Importinator::Mesh &mesh) {
+    CacheHeader header{};
+    header.magic = MAGIC;
+    header.version = MeshCache::VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.postProcessing = postProcessing;
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    header.submeshCount = mesh.submeshes.size();
+    header.lodCount = mesh.lods.size();
+    for (uint32_t axis = 0; axis < 3; ++axis) {
+        header.boundsMin[axis] = mesh.boundsMin[axis];
+        header.boundsMax[axis] = mesh.boundsMax[axis];
+    }
+    if (!describeSource(sourceFile, header.sourceSize, header.sourceModifiedTime)) return;
+
+    // Payload sections in file order
+    std::vector<LodHeader> lodHeaders{};
+    for (const auto &lod: mesh.lods) {
+        lodHeaders.push_back({.cellSize = lod.cellSize, .vertexCount = lod.vertices.size(),
+                              .indexCount = lod.indices.size()});
+    }
+    std::vector<std::pair<const void *, size_t>> sections{
+            {mesh.vertices.data(),  mesh.vertices.size() * sizeof(Vertex)},
+            {mesh.indices.data(),   mesh.indices.size() * sizeof(uint32_t)},
+            {mesh.submeshes.data(), mesh.submeshes.size() * sizeof(Importinator::Submesh)},
+            {lodHeaders.data(),     lodHeaders.size() * sizeof(LodHeader)}
+    };
+    for (const auto &lod: mesh.lods) {
+        sections.emplace_back(lod.vertices.data(), lod.vertices.size() * sizeof(Vertex));
+        sections.emplace_back(lod.indices.data(), lod.indices.size() * sizeof(uint32_t));
+    }
+
+    // Streaming the sections is the same as hashing them back to back
+    PayloadHash hash{};
+    for (const auto &[data, size]: sections) {
+        hash.update(static_cast<const std::byte *>(data), size);
+    }
+    header.checksum = hash.finish();
+
+    // Write to a temporary file first, so a crash never leaves a half written cache behind
+    const std::string cachePath = getCachePath(sourceFile);
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &[data, size]: sections) {
+            file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        }
+        if (!file) {
+            DBG "Failed to write mesh cache " << cachePath ENDL;
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        DBG "Failed to write mesh cache " << cachePath << ": " << error.message() ENDL;
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+
+    DBG "Wrote mesh cache " << cachePath ENDL;
+}
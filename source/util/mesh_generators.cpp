@@ -0,0 +1,326 @@
+//
+// Created by Saman on 22.09.23.
+//
+
+#include "util/mesh_generators.h"
+#include "util/thread_pool.h"
+#include "util/mesh_processing.h"
+#include "util/timer.h"
+#include "io/printer.h"
+
+#include <glm/glm.hpp>
+#include <glm/ext/scalar_constants.hpp>
+#include <array>
+#include <map>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+constexpr size_t ROW_CHUNK_SIZE = 16;
+
+// http://blog.andreaskahler.com/2009/06/creating-icosphere-mesh-in-code.html
+// Counter clockwise when seen from outside
+const float T = (1.0f + std::sqrt(5.0f)) / 2.0f;
+const std::array<glm::vec3, 12> ICOSAHEDRON_VERTICES{
+        glm::vec3(-1, T, 0), glm::vec3(1, T, 0), glm::vec3(-1, -T, 0), glm::vec3(1, -T, 0),
+        glm::vec3(0, -1, T), glm::vec3(0, 1, T), glm::vec3(0, -1, -T), glm::vec3(0, 1, -T),
+        glm::vec3(T, 0, -1), glm::vec3(T, 0, 1), glm::vec3(-T, 0, -1), glm::vec3(-T, 0, 1)
+};
+const std::array<glm::uvec3, 20> ICOSAHEDRON_FACES{
+        glm::uvec3(0, 11, 5), glm::uvec3(0, 5, 1), glm::uvec3(0, 1, 7), glm::uvec3(0, 7, 10), glm::uvec3(0, 10, 11),
+        glm::uvec3(1, 5, 9), glm::uvec3(5, 11, 4), glm::uvec3(11, 10, 2), glm::uvec3(10, 7, 6), glm::uvec3(7, 1, 8),
+        glm::uvec3(3, 9, 4), glm::uvec3(3, 4, 2), glm::uvec3(3, 2, 6), glm::uvec3(3, 6, 8), glm::uvec3(3, 8, 9),
+        glm::uvec3(4, 9, 5), glm::uvec3(2, 4, 11), glm::uvec3(6, 2, 10), glm::uvec3(8, 6, 7), glm::uvec3(9, 8, 1)
+};
+
+Vertex sphereVertex(const glm::vec3 &direction) {
+    Vertex vertex{};
+    vertex.pos = glm::normalize(direction);
+    vertex.normal = vertex.pos;
+    vertex.uvw = glm::vec3(0.5f + std::atan2(vertex.pos.z, vertex.pos.x) / (2.0f * glm::pi<float>()),
+                           0.5f - std::asin(vertex.pos.y) / glm::pi<float>(), 0.0f);
+    return vertex;
+}
+
+Importinator::Mesh MeshGenerators::icosphere(uint32_t frequency) {
+    const auto startTime = Timer::now();
+    const uint64_t n = std::max(frequency, 1u);
+
+    // Shared vertices: 12 corners, then n - 1 per edge, then the interior of every face
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edgeIndices{};
+    for (const auto &face: ICOSAHEDRON_FACES) {
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            const uint32_t a = face[corner], b = face[(corner + 1) % 3];
+            edgeIndices.try_emplace({std::min(a, b), std::max(a, b)}, static_cast<uint32_t>(edgeIndices.size()));
+        }
+    }
+    const uint64_t interiorPerFace = (n - 1) * (n - 2) / 2;
+    const uint64_t firstInterior = 12 + 30 * (n - 1);
+    const uint64_t vertexCount = firstInterior + 20 * interiorPerFace;
+    const uint64_t indexCount = 20 * n * n * 3;
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+        THROW("Icosphere frequency " + std::to_string(frequency) + " exceeds 32 bit indices");
+    }
+
+    Importinator::Mesh out{};
+    out.vertices.resize(vertexCount);
+    out.indices.resize(indexCount);
+    out.hasTangents = false;
+    out.submeshes.push_back({.firstIndex = 0, .indexCount = static_cast<uint32_t>(indexCount),
+                             .firstVertex = 0, .vertexCount = static_cast<uint32_t>(vertexCount)});
+
+    for (uint32_t i = 0; i < 12; ++i) {
+        out.vertices[i] = sphereVertex(ICOSAHEDRON_VERTICES[i]);
+    }
+    for (const auto &[edge, edgeIndex]: edgeIndices) {
+        const glm::vec3 &from = ICOSAHEDRON_VERTICES[edge.first];
+        const glm::vec3 &to = ICOSAHEDRON_VERTICES[edge.second];
+        for (uint64_t k = 1; k < n; ++k) {
+            out.vertices[12 + edgeIndex * (n - 1) + k - 1] =
+                    sphereVertex(from + (to - from) * (static_cast<float>(k) / static_cast<float>(n)));
+        }
+    }
+
+    // Edges AB, AC and BC of every face, as first shared vertex index and whether they run from the higher corner
+    struct FaceEdge {
+        uint64_t first;
+        bool isReversed;
+    };
+    std::array<std::array<FaceEdge, 3>, 20> faceEdges{};
+    for (uint32_t face = 0; face < 20; ++face) {
+        const auto &corners = ICOSAHEDRON_FACES[face];
+        const std::array<std::pair<uint32_t, uint32_t>, 3> edges{
+                std::make_pair(corners[0], corners[1]), std::make_pair(corners[0], corners[2]),
+                std::make_pair(corners[1], corners[2])
+        };
+        for (uint32_t edge = 0; edge < 3; ++edge) {
+            const auto [from, to] = edges[edge];
+            faceEdges[face][edge] = {12 + edgeIndices.at({std::min(from, to), std::max(from, to)}) * (n - 1), from > to};
+        }
+    }
+
+    // Vertex (i, j) of a face lies at A + (B - A) * i / n + (C - A) * j / n
+    auto vertexIndex = [&](uint32_t face, uint64_t i, uint64_t j) -> uint32_t {
+        const auto &corners = ICOSAHEDRON_FACES[face];
+        // Edge vertices are numbered from the lower corner index to the higher one
+        auto onEdge = [&](uint32_t edge, uint64_t step) {
+            const FaceEdge &faceEdge = faceEdges[face][edge];
+            return static_cast<uint32_t>(faceEdge.first + (faceEdge.isReversed ? n - step : step) - 1);
+        };
+
+        if (i == 0 && j == 0) return corners[0];
+        if (i == n) return corners[1];
+        if (j == n) return corners[2];
+        if (j == 0) return onEdge(0, i);
+        if (i == 0) return onEdge(1, j);
+        if (i + j == n) return onEdge(2, j);
+
+        // Interior rows i = 1 .. n - 2, each with j = 1 .. n - 1 - i
+        const uint64_t row = (i - 1) * (n - 1) - (i - 1) * i / 2;
+        return static_cast<uint32_t>(firstInterior + face * interiorPerFace + row + j - 1);
+    };
+
+    ThreadPool::parallelFor(20 * n, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t faceRow = begin; faceRow < end; ++faceRow) {
+            const auto face = static_cast<uint32_t>(faceRow / n);
+            const uint64_t i = faceRow % n;
+            const auto &corners = ICOSAHEDRON_FACES[face];
+            const glm::vec3 &a = ICOSAHEDRON_VERTICES[corners[0]];
+            const glm::vec3 &b = ICOSAHEDRON_VERTICES[corners[1]];
+            const glm::vec3 &c = ICOSAHEDRON_VERTICES[corners[2]];
+
+            for (uint64_t j = 1; i > 0 && i + j < n; ++j) {
+                const glm::vec3 direction = a + (b - a) * (static_cast<float>(i) / static_cast<float>(n)) +
+                                            (c - a) * (static_cast<float>(j) / static_cast<float>(n));
+                out.vertices[vertexIndex(face, i, j)] = sphereVertex(direction);
+            }
+
+            // Row i holds 2 * (n - i) - 1 triangles, and starts after the 2 * i * n - i * i triangles of earlier rows
+            uint32_t *indices = out.indices.data() + (face * n * n + 2 * i * n - i * i) * 3;
+            for (uint64_t j = 0; j + i < n; ++j) {
+                *indices++ = vertexIndex(face, i, j);
+                *indices++ = vertexIndex(face, i + 1, j);
+                *indices++ = vertexIndex(face, i, j + 1);
+                if (i + j + 1 < n) {
+                    *indices++ = vertexIndex(face, i + 1, j);
+                    *indices++ = vertexIndex(face, i + 1, j + 1);
+                    *indices++ = vertexIndex(face, i, j + 1);
+                }
+            }
+        }
+    }, ROW_CHUNK_SIZE);
+
+    DBG "Generated icosphere with " << indexCount / 3 << " triangles in " << Timer::duration(startTime, Timer::now())
+        << " seconds" ENDL;
+    return out;
+}
+
+// Hash based value noise, a few octaves of it
+float hashNoise(int32_t x, int32_t y) {
+    uint32_t hash = static_cast<uint32_t>(x) * 374761393u + static_cast<uint32_t>(y) * 668265263u;
+    hash = (hash ^ (hash >> 13)) * 1274126177u;
+    return static_cast<float>(hash ^ (hash >> 16)) / static_cast<float>(UINT32_MAX);
+}
+
+float valueNoise(glm::vec2 position) {
+    const glm::vec2 cell = glm::floor(position);
+    const glm::vec2 t = position - cell;
+    const glm::vec2 smooth = t * t * (3.0f - 2.0f * t);
+    const auto x = static_cast<int32_t>(cell.x), y = static_cast<int32_t>(cell.y);
+    return glm::mix(glm::mix(hashNoise(x, y), hashNoise(x + 1, y), smooth.x),
+                    glm::mix(hashNoise(x, y + 1), hashNoise(x + 1, y + 1), smooth.x), smooth.y);
+}
+
+float terrainHeight(glm::vec2 position) {
+    float height = 0.0f, amplitude = 0.5f;
+    for (uint32_t octave = 0; octave < 6; ++octave) {
+        height += valueNoise(position) * amplitude;
+        position *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return height;
+}
+
+Importinator::Mesh MeshGenerators::terrain(uint32_t resolution, float size, float height) {
+    const auto startTime = Timer::now();
+    const uint64_t n = std::max(resolution, 1u);
+    const uint64_t vertexCount = (n + 1) * (n + 1);
+    const uint64_t indexCount = n * n * 6;
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+        THROW("Terrain resolution " + std::to_string(resolution) + " exceeds 32 bit indices");
+    }
+
+    Importinator::Mesh out{};
+    out.vertices.resize(vertexCount);
+    out.indices.resize(indexCount);
+    out.hasTangents = false;
+    out.submeshes.push_back({.firstIndex = 0, .indexCount = static_cast<uint32_t>(indexCount),
+                             .firstVertex = 0, .vertexCount = static_cast<uint32_t>(vertexCount)});
+
+    const float step = size / static_cast<float>(n);
+    const float noiseScale = 8.0f / size; // Features independent of the resolution
+    auto heightAt = [&](float x, float y) {
+        return -terrainHeight(glm::vec2(x, y) * noiseScale) * height;
+    };
+
+    ThreadPool::parallelFor(n + 1, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t row = begin; row < end; ++row) {
+            for (uint64_t column = 0; column <= n; ++column) {
+                const float x = static_cast<float>(column) * step - size * 0.5f;
+                const float y = static_cast<float>(row) * step - size * 0.5f;
+
+                Vertex &vertex = out.vertices[row * (n + 1) + column];
+                vertex.pos = glm::vec3(x, y, heightAt(x, y));
+                // Central differences. The surface is z = h(x, y), facing -Z.
+                const float dx = (heightAt(x + step, y) - heightAt(x - step, y)) / (2.0f * step);
+                const float dy = (heightAt(x, y + step) - heightAt(x, y - step)) / (2.0f * step);
+                vertex.normal = glm::normalize(glm::vec3(dx, dy, -1.0f));
+                vertex.uvw = glm::vec3(static_cast<float>(column) / static_cast<float>(n),
+                                       static_cast<float>(row) / static_cast<float>(n), 0.0f);
+            }
+
+            if (row == n) continue;
+            uint32_t *indices = out.indices.data() + row * n * 6;
+            for (uint64_t column = 0; column < n; ++column) {
+                const auto corner = static_cast<uint32_t>(row * (n + 1) + column);
+                const auto nextRow = static_cast<uint32_t>(corner + n + 1);
+                // Counter clockwise when seen from -Z
+                for (const uint32_t index: {corner, nextRow, corner + 1, corner + 1, nextRow, nextRow + 1}) {
+                    *indices++ = index;
+                }
+            }
+        }
+    }, ROW_CHUNK_SIZE);
+
+    DBG "Generated terrain with " << indexCount / 3 << " triangles in " << Timer::duration(startTime, Timer::now())
+        << " seconds" ENDL;
+    return out;
+}
+
+Importinator::Mesh MeshGenerators::tiled(const Importinator::Mesh &mesh, uint32_t countX, uint32_t countY,
+                                         float spacing) {
+    const auto startTime = Timer::now();
+    const uint64_t copies = static_cast<uint64_t>(countX) * countY;
+    const uint64_t vertexCount = copies * mesh.vertices.size();
+    const uint64_t indexCount = copies * mesh.indices.size();
+    if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+        THROW("Tiling " + std::to_string(copies) + " copies exceeds 32 bit indices");
+    }
+
+    Importinator::Mesh out{};
+    out.vertices.resize(vertexCount);
+    out.indices.resize(indexCount);
+    out.hasNormals = mesh.hasNormals;
+    out.hasTangents = mesh.hasTangents;
+    out.submeshes.resize(copies);
+
+    const glm::vec2 center = glm::vec2(static_cast<float>(countX - 1), static_cast<float>(countY - 1)) * 0.5f;
+    ThreadPool::parallelFor(copies, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t copy = begin; copy < end; ++copy) {
+            const glm::vec2 cell = glm::vec2(static_cast<float>(copy % countX), static_cast<float>(copy / countX));
+            const glm::vec3 offset = glm::vec3((cell - center) * spacing, 0.0f);
+            const auto firstVertex = static_cast<uint32_t>(copy * mesh.vertices.size());
+            const auto firstIndex = static_cast<uint32_t>(copy * mesh.indices.size());
+
+            for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+                out.vertices[firstVertex + i] = mesh.vertices[i];
+                out.vertices[firstVertex + i].pos += offset;
+            }
+            for (size_t i = 0; i < mesh.indices.size(); ++i) {
+                out.indices[firstIndex + i] = mesh.indices[i] + firstVertex;
+            }
+            out.submeshes[copy] = {.firstIndex = firstIndex, .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+                                   .firstVertex = firstVertex,
+                                   .vertexCount = static_cast<uint32_t>(mesh.vertices.size())};
+        }
+    }, 1);
+
+    DBG "Generated " << copies << " tiled copies with " << indexCount / 3 << " triangles in "
+        << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+    return out;
+}
+
+std::optional<Importinator::Mesh> MeshGenerators::fromSpec(const std::string &spec) {
+    // The count comes after the last ':', so file names may contain ':' themselves, e.g. Windows drive letters
+    const size_t kindEnd = spec.find(':');
+    const size_t countBegin = spec.rfind(':');
+    const std::string kind = spec.substr(0, kindEnd);
+
+    std::optional<Importinator::Mesh> out{};
+    // Generated meshes lack tangents, LODs and the spatial order, just like freshly imported ones
+    uint32_t steps = Importinator::POST_PROCESS_ALL;
+    try {
+        if (kindEnd != std::string::npos) {
+            const auto count = static_cast<uint32_t>(std::stoul(spec.substr(countBegin + 1)));
+            if (countBegin == kindEnd && kind == "icosphere") {
+                out = icosphere(count);
+            } else if (countBegin == kindEnd && kind == "terrain") {
+                out = terrain(count);
+            } else if (countBegin > kindEnd && kind == "tiled") {
+                const Importinator::Mesh mesh = Importinator::importMesh(
+                        spec.substr(kindEnd + 1, countBegin - kindEnd - 1));
+                // Spaced by the size of the mesh, so copies do not overlap
+                glm::vec2 min{INFINITY}, max{-INFINITY};
+                for (const auto &vertex: mesh.vertices) {
+                    min = glm::min(min, glm::vec2(vertex.pos));
+                    max = glm::max(max, glm::vec2(vertex.pos));
+                }
+                const glm::vec2 extent = mesh.vertices.empty() ? glm::vec2(1.0f) : max - min;
+                out = tiled(mesh, count, count, std::max(extent.x, extent.y) * 1.1f);
+                // The copies keep the welding, attributes and order of the imported mesh, but not its LODs
+                steps = Importinator::POST_PROCESS_LOD_CHAIN;
+            }
+        }
+    } catch (const std::logic_error &) {
+        // Not a number, handled below
+    }
+
+    if (!out.has_value()) {
+        DBG "Invalid mesh generator spec " << spec ENDL;
+        return std::nullopt;
+    }
+
+    MeshProcessing::process(*out, steps);
+    return out;
+}
@@ -0,0 +1,636 @@
+//
+// Created by Saman on 20.09.23.
+//
+
+#include "util/mesh_processing.h"
+#include "util/thread_pool.h"
+#include "util/timer.h"
+#include "io/printer.h"
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <utility>
+
+constexpr float WELD_TOLERANCE = 1e-6f; // Relative to the largest bounding box extent
+constexpr size_t VERTEX_CHUNK_SIZE = 16384;
+constexpr size_t TRIANGLE_CHUNK_SIZE = 16384;
+constexpr float LOD_FINEST_RESOLUTION = 512.0f; // Grid cells along the longest axis of the finest LOD
+constexpr uint32_t MAX_LODS = 8;
+constexpr size_t LOD_MIN_TRIANGLES = 64;
+constexpr size_t CLUSTER_TRIANGLES = 256;
+constexpr size_t CLUSTER_CHUNK_SIZE = 16; // Clusters
+constexpr float CONE_DISABLED = 2.0f; // Larger than any cosine
+
+// Identical positions always land in the same cell. Near duplicates that straddle a cell border stay separate.
+uint64_t hashCell(const glm::vec3 &position, float inverseCellSize) {
+    const auto x = static_cast<int64_t>(std::floor(position.x * inverseCellSize));
+    const auto y = static_cast<int64_t>(std::floor(position.y * inverseCellSize));
+    const auto z = static_cast<int64_t>(std::floor(position.z * inverseCellSize));
+    // https://matthias-research.github.io/pages/publications/tetraederCollision.pdf
+    return static_cast<uint64_t>(x * 73856093) ^ static_cast<uint64_t>(y * 19349663) ^
+           static_cast<uint64_t>(z * 83492791);
+}
+
+bool isSameVertex(const Vertex &a, const Vertex &b, float toleranceSquared) {
+    const glm::vec3 delta = a.pos - b.pos;
+    return glm::dot(delta, delta) <= toleranceSquared &&
+           a.color == b.color && a.normal == b.normal && a.tangent == b.tangent &&
+           a.bitangent == b.bitangent && a.uvw == b.uvw;
+}
+
+void MeshProcessing::weldVertices(Importinator::Mesh &mesh) {
+    const size_t vertexCount = mesh.vertices.size();
+    if (vertexCount == 0) return;
+
+    // Tolerance from the bounding box
+    const uint32_t boundsChunks = ThreadPool::getChunkCount(vertexCount, VERTEX_CHUNK_SIZE);
+    std::vector<glm::vec3> chunkMin(boundsChunks, glm::vec3(INFINITY));
+    std::vector<glm::vec3> chunkMax(boundsChunks, glm::vec3(-INFINITY));
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            chunkMin[chunk] = glm::min(chunkMin[chunk], mesh.vertices[i].pos);
+            chunkMax[chunk] = glm::max(chunkMax[chunk], mesh.vertices[i].pos);
+        }
+    }, VERTEX_CHUNK_SIZE);
+    glm::vec3 min = chunkMin[0], max = chunkMax[0];
+    for (uint32_t i = 1; i < boundsChunks; ++i) {
+        min = glm::min(min, chunkMin[i]);
+        max = glm::max(max, chunkMax[i]);
+    }
+    const glm::vec3 extent = max - min;
+    const float tolerance = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-12f)) * WELD_TOLERANCE;
+    const float inverseCellSize = 1.0f / tolerance;
+    const float toleranceSquared = tolerance * tolerance;
+
+    // Submeshes are welded separately, so their vertex ranges stay contiguous
+    std::vector<uint32_t> submeshOf(vertexCount, 0);
+    ThreadPool::parallelFor(mesh.submeshes.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t submesh = begin; submesh < end; ++submesh) {
+            const auto &range = mesh.submeshes[submesh];
+            std::fill_n(submeshOf.begin() + range.firstVertex, range.vertexCount, static_cast<uint32_t>(submesh));
+        }
+    }, 1);
+
+    // Hash every vertex into a grid cell, and partition the vertices into one bucket per thread by cell.
+    // Buckets keep the original vertex order, so the first vertex of every group becomes its representative.
+    const uint32_t chunkCount = ThreadPool::getChunkCount(vertexCount, VERTEX_CHUNK_SIZE);
+    const uint32_t bucketCount = chunkCount;
+    std::vector<uint64_t> cells(vertexCount);
+    std::vector<uint32_t> bucketSizes(chunkCount * bucketCount, 0); // [chunk][bucket]
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            cells[i] = hashCell(mesh.vertices[i].pos, inverseCellSize) ^ (static_cast<uint64_t>(submeshOf[i]) << 40);
+            bucketSizes[chunk * bucketCount + cells[i] % bucketCount]++;
+        }
+    }, VERTEX_CHUNK_SIZE);
+
+    // Exclusive prefix sum, bucket major, so each chunk writes its part of every bucket without contention
+    std::vector<uint32_t> bucketOffsets(chunkCount * bucketCount);
+    std::vector<uint32_t> bucketBegin(bucketCount + 1);
+    uint32_t offset = 0;
+    for (uint32_t bucket = 0; bucket < bucketCount; ++bucket) {
+        bucketBegin[bucket] = offset;
+        for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+            bucketOffsets[chunk * bucketCount + bucket] = offset;
+            offset += bucketSizes[chunk * bucketCount + bucket];
+        }
+    }
+    bucketBegin[bucketCount] = offset;
+
+    std::vector<uint32_t> sortedVertices(vertexCount);
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            sortedVertices[bucketOffsets[chunk * bucketCount + cells[i] % bucketCount]++] = static_cast<uint32_t>(i);
+        }
+    }, VERTEX_CHUNK_SIZE);
+
+    // Every bucket is welded independently
+    std::vector<uint32_t> representative(vertexCount);
+    ThreadPool::parallelFor(bucketCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t bucket = begin; bucket < end; ++bucket) {
+            std::unordered_map<uint64_t, std::vector<uint32_t>> candidates{};
+            candidates.reserve(bucketBegin[bucket + 1] - bucketBegin[bucket]);
+            for (uint32_t i = bucketBegin[bucket]; i < bucketBegin[bucket + 1]; ++i) {
+                const uint32_t vertex = sortedVertices[i];
+                auto &cell = candidates[cells[vertex]];
+                representative[vertex] = vertex;
+                for (const uint32_t candidate: cell) {
+                    if (submeshOf[candidate] == submeshOf[vertex] &&
+                        isSameVertex(mesh.vertices[candidate], mesh.vertices[vertex], toleranceSquared)) {
+                        representative[vertex] = candidate;
+                        break;
+                    }
+                }
+                if (representative[vertex] == vertex) {
+                    cell.push_back(vertex);
+                }
+            }
+        }
+    }, 1);
+
+    // Compact the representatives, keeping their order
+    std::vector<uint32_t> keptPerChunk(chunkCount, 0);
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        for (size_t i = begin; i < end; ++i) {
+            keptPerChunk[chunk] += representative[i] == i;
+        }
+    }, VERTEX_CHUNK_SIZE);
+    std::vector<uint32_t> chunkOffsets(chunkCount, 0);
+    for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+        chunkOffsets[chunk] = chunkOffsets[chunk - 1] + keptPerChunk[chunk - 1];
+    }
+    const uint32_t weldedCount = chunkOffsets[chunkCount - 1] + keptPerChunk[chunkCount - 1];
+    if (weldedCount == vertexCount) return;
+
+    std::vector<uint32_t> newIndex(vertexCount);
+    std::vector<Vertex> welded(weldedCount);
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        uint32_t next = chunkOffsets[chunk];
+        for (size_t i = begin; i < end; ++i) {
+            if (representative[i] == i) {
+                newIndex[i] = next;
+                welded[next++] = mesh.vertices[i];
+            }
+        }
+    }, VERTEX_CHUNK_SIZE);
+
+    ThreadPool::parallelFor(mesh.indices.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+            mesh.indices[i] = newIndex[representative[mesh.indices[i]]];
+        }
+    }, VERTEX_CHUNK_SIZE);
+
+    // Submeshes are back to back. The first vertex of a submesh is always kept, nothing before it could replace it.
+    uint32_t nextFirst = weldedCount;
+    for (size_t submesh = mesh.submeshes.size(); submesh-- > 0;) {
+        auto &range = mesh.submeshes[submesh];
+        const uint32_t first = range.vertexCount > 0 ? newIndex[range.firstVertex] : nextFirst;
+        range.vertexCount = nextFirst - first;
+        range.firstVertex = first;
+        nextFirst = first;
+    }
+
+    DBG "\tWelded " << vertexCount << " vertices into " << weldedCount ENDL;
+    mesh.vertices = std::move(welded);
+}
+
+// Sums per triangle contributions into one buffer per thread, then reduces them per vertex.
+// This costs a vertex sized buffer per thread, but needs no atomics.
+template<typename Accumulator, typename PerTriangle, typename PerVertex>
+void accumulateTriangles(Importinator::Mesh &mesh, PerTriangle perTriangle, PerVertex perVertex) {
+    const size_t vertexCount = mesh.vertices.size();
+    const size_t triangleCount = mesh.indices.size() / 3;
+    const uint32_t chunkCount = ThreadPool::getChunkCount(triangleCount, TRIANGLE_CHUNK_SIZE);
+
+    std::vector<std::vector<Accumulator>> buffers(chunkCount);
+    ThreadPool::parallelFor(triangleCount, [&](size_t begin, size_t end, uint32_t chunk) {
+        auto &buffer = buffers[chunk];
+        buffer.assign(vertexCount, Accumulator{});
+        for (size_t triangle = begin; triangle < end; ++triangle) {
+            const uint32_t *corners = &mesh.indices[triangle * 3];
+            perTriangle(corners, buffer);
+        }
+    }, TRIANGLE_CHUNK_SIZE);
+
+    ThreadPool::parallelFor(vertexCount, [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+            Accumulator sum = buffers[0][i];
+            for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+                sum += buffers[chunk][i];
+            }
+            perVertex(mesh.vertices[i], sum);
+        }
+    }, VERTEX_CHUNK_SIZE);
+}
+
+void MeshProcessing::generateNormals(Importinator::Mesh &mesh) {
+    accumulateTriangles<glm::vec3>(mesh, [&](const uint32_t *corners, std::vector<glm::vec3> &normals) {
+        const glm::vec3 &a = mesh.vertices[corners[0]].pos;
+        const glm::vec3 &b = mesh.vertices[corners[1]].pos;
+        const glm::vec3 &c = mesh.vertices[corners[2]].pos;
+        const glm::vec3 faceNormal = glm::cross(b - a, c - a); // Length is twice the area
+        normals[corners[0]] += faceNormal;
+        normals[corners[1]] += faceNormal;
+        normals[corners[2]] += faceNormal;
+    }, [](Vertex &vertex, const glm::vec3 &normal) {
+        const float length = glm::length(normal);
+        vertex.normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    });
+    mesh.hasNormals = true;
+}
+
+struct TangentSum {
+    glm::vec3 tangent{0.0f};
+    glm::vec3 bitangent{0.0f};
+
+    TangentSum &operator+=(const TangentSum &other) {
+        tangent += other.tangent;
+        bitangent += other.bitangent;
+        return *this;
+    }
+};
+
+void MeshProcessing::generateTangents(Importinator::Mesh &mesh) {
+    // http://www.terathon.com/code/tangent.html
+    accumulateTriangles<TangentSum>(mesh, [&](const uint32_t *corners, std::vector<TangentSum> &sums) {
+        const Vertex &a = mesh.vertices[corners[0]];
+        const Vertex &b = mesh.vertices[corners[1]];
+        const Vertex &c = mesh.vertices[corners[2]];
+        const glm::vec3 edge1 = b.pos - a.pos;
+        const glm::vec3 edge2 = c.pos - a.pos;
+        const glm::vec2 uv1 = glm::vec2(b.uvw - a.uvw);
+        const glm::vec2 uv2 = glm::vec2(c.uvw - a.uvw);
+
+        const float determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+        if (std::abs(determinant) < 1e-12f) return; // No usable UV mapping
+
+        const float r = 1.0f / determinant;
+        const TangentSum sum{
+                .tangent = (edge1 * uv2.y - edge2 * uv1.y) * r,
+                .bitangent = (edge2 * uv1.x - edge1 * uv2.x) * r
+        };
+        sums[corners[0]] += sum;
+        sums[corners[1]] += sum;
+        sums[corners[2]] += sum;
+    }, [](Vertex &vertex, const TangentSum &sum) {
+        const glm::vec3 &n = vertex.normal;
+        // Gram-Schmidt against the normal
+        glm::vec3 tangent = sum.tangent - n * glm::dot(n, sum.tangent);
+        if (glm::dot(tangent, tangent) < 1e-20f) {
+            // Any direction perpendicular to the normal
+            tangent = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1, 0, 0)) : glm::cross(n, glm::vec3(0, 1, 0));
+        }
+        vertex.tangent = glm::normalize(tangent);
+        const float handedness = glm::dot(glm::cross(n, vertex.tangent), sum.bitangent) < 0.0f ? -1.0f : 1.0f;
+        vertex.bitangent = glm::cross(n, vertex.tangent) * handedness;
+    });
+    mesh.hasTangents = true;
+}
+
+// Spreads the lower 21 bits of value out to every third bit
+uint64_t spreadBits(uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+// https://en.wikipedia.org/wiki/Z-order_curve
+uint64_t mortonCode(const glm::vec3 &normalized) {
+    const glm::vec3 scaled = glm::clamp(normalized, 0.0f, 1.0f) * static_cast<float>(0x1fffff);
+    return spreadBits(static_cast<uint64_t>(scaled.x)) |
+           spreadBits(static_cast<uint64_t>(scaled.y)) << 1 |
+           spreadBits(static_cast<uint64_t>(scaled.z)) << 2;
+}
+
+void MeshProcessing::reorderSpatially(Importinator::Mesh &mesh) {
+    std::vector<Importinator::Submesh> ranges = mesh.submeshes;
+    if (ranges.empty()) {
+        ranges.push_back({.firstIndex = 0, .indexCount = static_cast<uint32_t>(mesh.indices.size()),
+                          .firstVertex = 0, .vertexCount = static_cast<uint32_t>(mesh.vertices.size())});
+    }
+
+    // Submeshes are independent, and stay in their ranges
+    std::vector<Vertex> sorted(mesh.vertices.size());
+    std::vector<uint32_t> newIndex(mesh.vertices.size());
+    ThreadPool::parallelFor(ranges.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t submesh = begin; submesh < end; ++submesh) {
+            const auto &range = ranges[submesh];
+            if (range.vertexCount == 0) continue;
+
+            const Vertex *vertices = mesh.vertices.data() + range.firstVertex;
+            glm::vec3 min = vertices[0].pos, max = vertices[0].pos;
+            for (uint32_t i = 0; i < range.vertexCount; ++i) {
+                min = glm::min(min, vertices[i].pos);
+                max = glm::max(max, vertices[i].pos);
+            }
+            const glm::vec3 inverseExtent = 1.0f / glm::max(max - min, glm::vec3(1e-12f));
+
+            std::vector<std::pair<uint64_t, uint32_t>> order(range.vertexCount);
+            for (uint32_t i = 0; i < range.vertexCount; ++i) {
+                order[i] = {mortonCode((vertices[i].pos - min) * inverseExtent), i};
+            }
+            std::sort(order.begin(), order.end());
+
+            for (uint32_t i = 0; i < range.vertexCount; ++i) {
+                newIndex[range.firstVertex + order[i].second] = range.firstVertex + i;
+                sorted[range.firstVertex + i] = vertices[order[i].second];
+            }
+
+            // Remap, rotate the lowest index to the front keeping the winding, and sort by it
+            std::vector<glm::uvec3> triangles(range.indexCount / 3);
+            const uint32_t *indices = mesh.indices.data() + range.firstIndex;
+            for (size_t i = 0; i < triangles.size(); ++i) {
+                glm::uvec3 triangle{newIndex[indices[i * 3]], newIndex[indices[i * 3 + 1]],
+                                    newIndex[indices[i * 3 + 2]]};
+                while (triangle.x > triangle.y || triangle.x > triangle.z) {
+                    triangle = {triangle.y, triangle.z, triangle.x};
+                }
+                triangles[i] = triangle;
+            }
+            std::stable_sort(triangles.begin(), triangles.end(), [](const glm::uvec3 &a, const glm::uvec3 &b) {
+                return a.x < b.x;
+            });
+            uint32_t *outIndices = mesh.indices.data() + range.firstIndex;
+            for (size_t i = 0; i < triangles.size(); ++i) {
+                outIndices[i * 3] = triangles[i].x;
+                outIndices[i * 3 + 1] = triangles[i].y;
+                outIndices[i * 3 + 2] = triangles[i].z;
+            }
+        }
+    }, 1);
+
+    mesh.vertices = std::move(sorted);
+}
+
+size_t MeshProcessing::countCacheMisses(const std::vector<uint32_t> &indices, size_t elementSize) {
+    constexpr size_t LINE_SIZE = 64;
+    constexpr size_t WAYS = 8;
+    constexpr size_t SETS = 32 * 1024 / LINE_SIZE / WAYS;
+
+    // Per set, the most recently used line first
+    std::vector<std::array<uint64_t, WAYS>> sets(SETS);
+    for (auto &set: sets) set.fill(UINT64_MAX);
+
+    size_t misses = 0;
+    auto touch = [&](uint64_t line) {
+        auto &set = sets[line % SETS];
+        auto it = std::find(set.begin(), set.end(), line);
+        if (it == set.end()) {
+            ++misses;
+            it = set.end() - 1; // Evict the least recently used
+        }
+        std::rotate(set.begin(), it, it + 1);
+        set[0] = line;
+    };
+
+    for (const uint32_t index: indices) {
+        const uint64_t begin = static_cast<uint64_t>(index) * elementSize;
+        for (uint64_t line = begin / LINE_SIZE; line <= (begin + elementSize - 1) / LINE_SIZE; ++line) {
+            touch(line);
+        }
+    }
+    return misses;
+}
+
+size_t MeshProcessing::getClusterCount(size_t indexCount) {
+    return (indexCount / 3 + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES + 1;
+}
+
+std::vector<MeshCluster>
+MeshProcessing::buildClusters(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+    const size_t triangleCount = indices.size() / 3;
+    const size_t partCount = (triangleCount + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES;
+
+    // One extra cluster up front for the whole mesh
+    std::vector<MeshCluster> clusters(partCount + 1);
+    std::vector<glm::vec3> partMin(partCount), partMax(partCount);
+
+    ThreadPool::parallelFor(partCount, [&](size_t begin, size_t end, uint32_t) {
+        std::vector<glm::vec3> faceNormals{};
+        faceNormals.reserve(CLUSTER_TRIANGLES);
+
+        for (size_t part = begin; part < end; ++part) {
+            const size_t firstTriangle = part * CLUSTER_TRIANGLES;
+            const size_t endTriangle = std::min(firstTriangle + CLUSTER_TRIANGLES, triangleCount);
+
+            glm::vec3 min{INFINITY}, max{-INFINITY}, axis{0.0f};
+            faceNormals.clear();
+            for (size_t triangle = firstTriangle; triangle < endTriangle; ++triangle) {
+                const Vertex &a = vertices[indices[triangle * 3]];
+                const Vertex &b = vertices[indices[triangle * 3 + 1]];
+                const Vertex &c = vertices[indices[triangle * 3 + 2]];
+                min = glm::min(min, glm::min(a.pos, glm::min(b.pos, c.pos)));
+                max = glm::max(max, glm::max(a.pos, glm::max(b.pos, c.pos)));
+
+                const glm::vec3 cross = glm::cross(b.pos - a.pos, c.pos - a.pos);
+                const float length = glm::length(cross);
+                if (length <= 0.0f) continue; // Degenerate, never rasterized
+                // Point the face normal outwards like the vertex normals, whichever winding the importer produced
+                glm::vec3 normal = cross / length;
+                if (glm::dot(normal, a.normal + b.normal + c.normal) < 0.0f) normal = -normal;
+                faceNormals.push_back(normal);
+                axis += normal;
+            }
+
+            const glm::vec3 center = (min + max) * 0.5f;
+            float radiusSquared = 0.0f;
+            for (size_t i = firstTriangle * 3; i < endTriangle * 3; ++i) {
+                const glm::vec3 offset = vertices[indices[i]].pos - center;
+                radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+            }
+
+            // Widest angle between the average direction and any face. Cones of 90 degrees or more never cull.
+            float cutoff = CONE_DISABLED;
+            const float axisLength = glm::length(axis);
+            if (axisLength > 0.0f) {
+                axis /= axisLength;
+                float minDot = 1.0f;
+                for (const auto &normal: faceNormals) {
+                    minDot = std::min(minDot, glm::dot(normal, axis));
+                }
+                // Back facing for cameras within 90 degrees minus the spread around -axis, so sin(spread)
+                if (minDot > 0.0f) cutoff = std::sqrt(1.0f - minDot * minDot);
+            }
+
+            partMin[part] = min;
+            partMax[part] = max;
+            clusters[part + 1] = {
+                    .bounds = glm::vec4(center, std::sqrt(radiusSquared)),
+                    .cone = glm::vec4(axis, cutoff),
+                    .firstIndex = static_cast<uint32_t>(firstTriangle * 3),
+                    .indexCount = static_cast<uint32_t>((endTriangle - firstTriangle) * 3)
+            };
+        }
+    }, CLUSTER_CHUNK_SIZE);
+
+    glm::vec3 min{INFINITY}, max{-INFINITY};
+    for (size_t part = 0; part < partCount; ++part) {
+        min = glm::min(min, partMin[part]);
+        max = glm::max(max, partMax[part]);
+    }
+    const glm::vec3 center = partCount > 0 ? (min + max) * 0.5f : glm::vec3(0.0f);
+    float radius = 0.0f;
+    for (size_t part = 1; part <= partCount; ++part) {
+        const glm::vec4 &bounds = clusters[part].bounds;
+        radius = std::max(radius, glm::length(glm::vec3(bounds) - center) + bounds.w);
+    }
+    clusters[0] = {
+            .bounds = glm::vec4(center, radius),
+            .cone = glm::vec4(0.0f, 0.0f, 0.0f, CONE_DISABLED),
+            .firstIndex = 0,
+            .indexCount = static_cast<uint32_t>(triangleCount * 3)
+    };
+
+    return clusters;
+}
+
+// Keeps the vertex closest to each cell's center, so all attributes stay as they were
+Importinator::Lod clusterVertices(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+                                  const glm::vec3 &origin, float cellSize) {
+    Importinator::Lod out{.cellSize = cellSize};
+    const float inverseCellSize = 1.0f / cellSize;
+
+    std::vector<glm::ivec3> cells(vertices.size());
+    ThreadPool::parallelFor(vertices.size(), [&](size_t begin, size_t end, uint32_t) {
+        for (size_t i = begin; i < end; ++i) {
+            cells[i] = glm::ivec3(glm::floor((vertices[i].pos - origin) * inverseCellSize));
+        }
+    }, VERTEX_CHUNK_SIZE);
+
+    // 21 bits per axis, the grid never has more than LOD_FINEST_RESOLUTION cells per axis
+    auto key = [](const glm::ivec3 &cell) {
+        return (static_cast<uint64_t>(cell.x) << 42) | (static_cast<uint64_t>(cell.y) << 21) |
+               static_cast<uint64_t>(cell.z);
+    };
+
+    struct Cluster {
+        uint32_t vertex;
+        float distanceSquared;
+    };
+    std::unordered_map<uint64_t, uint32_t> clusterOfCell{};
+    std::vector<Cluster> clusters{};
+    std::vector<uint32_t> clusterOfVertex(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); ++i) {
+        const glm::vec3 center = origin + (glm::vec3(cells[i]) + 0.5f) * cellSize;
+        const glm::vec3 offset = vertices[i].pos - center;
+        const float distanceSquared = glm::dot(offset, offset);
+
+        auto [it, inserted] = clusterOfCell.try_emplace(key(cells[i]), static_cast<uint32_t>(clusters.size()));
+        if (inserted) {
+            clusters.push_back({i, distanceSquared});
+        } else if (distanceSquared < clusters[it->second].distanceSquared) {
+            clusters[it->second] = {i, distanceSquared};
+        }
+        clusterOfVertex[i] = it->second;
+    }
+
+    out.vertices.reserve(clusters.size());
+    for (const auto &cluster: clusters) {
+        out.vertices.push_back(vertices[cluster.vertex]);
+    }
+
+    // Collapsed triangles are dropped, and duplicates are found by sorting rotated triangles
+    std::vector<glm::uvec3> triangles{};
+    triangles.reserve(indices.size() / 3);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        glm::uvec3 triangle{clusterOfVertex[indices[i]], clusterOfVertex[indices[i + 1]],
+                            clusterOfVertex[indices[i + 2]]};
+        if (triangle.x == triangle.y || triangle.x == triangle.z || triangle.y == triangle.z) continue;
+        // Lowest index first, keeping the winding
+        while (triangle.x > triangle.y || triangle.x > triangle.z) {
+            triangle = {triangle.y, triangle.z, triangle.x};
+        }
+        triangles.push_back(triangle);
+    }
+    auto less = [](const glm::uvec3 &a, const glm::uvec3 &b) {
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    std::sort(triangles.begin(), triangles.end(), less);
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    out.indices.reserve(triangles.size() * 3);
+    for (const auto &triangle: triangles) {
+        out.indices.insert(out.indices.end(), {triangle.x, triangle.y, triangle.z});
+    }
+    return out;
+}
+
+void MeshProcessing::generateLodChain(Importinator::Mesh &mesh) {
+    mesh.lods.clear();
+    if (mesh.vertices.empty()) return;
+
+    glm::vec3 min = mesh.vertices[0].pos, max = mesh.vertices[0].pos;
+    for (const auto &vertex: mesh.vertices) {
+        min = glm::min(min, vertex.pos);
+        max = glm::max(max, vertex.pos);
+    }
+    const glm::vec3 extent = max - min;
+    float cellSize = std::max(std::max(extent.x, extent.y), extent.z) / LOD_FINEST_RESOLUTION;
+    if (cellSize <= 0.0f) return;
+
+    // Every level clusters the previous one. The grids share their origin, so each cell is made of 2x2x2 finer cells.
+    mesh.lods.reserve(MAX_LODS);
+    const std::vector<Vertex> *vertices = &mesh.vertices;
+    const std::vector<uint32_t> *indices = &mesh.indices;
+    size_t previousTriangles = mesh.indices.size() / 3;
+    for (uint32_t level = 0; level < MAX_LODS && previousTriangles > LOD_MIN_TRIANGLES; ++level) {
+        Importinator::Lod lod = clusterVertices(*vertices, *indices, min, cellSize);
+        const size_t triangles = lod.indices.size() / 3;
+        if (triangles == 0) break;
+
+        cellSize *= 2.0f;
+        if (triangles == previousTriangles) continue; // Grid still finer than the mesh
+        previousTriangles = triangles;
+
+        mesh.lods.push_back(std::move(lod));
+        vertices = &mesh.lods.back().vertices;
+        indices = &mesh.lods.back().indices;
+    }
+
+    DBG "\tGenerated " << mesh.lods.size() << " LODs, coarsest with "
+        << (mesh.lods.empty() ? 0 : mesh.lods.back().indices.size() / 3) << " triangles" ENDL;
+}
+
+void MeshProcessing::computeBounds(Importinator::Mesh &mesh) {
+    mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+    if (mesh.vertices.empty()) return;
+
+    mesh.boundsMin = mesh.boundsMax = mesh.vertices[0].pos;
+    for (const auto &vertex: mesh.vertices) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, vertex.pos);
+        mesh.boundsMax = glm::max(mesh.boundsMax, vertex.pos);
+    }
+}
+
+void MeshProcessing::process(Importinator::Mesh &mesh, uint32_t steps) {
+    using namespace Importinator;
+
+    if (steps & POST_PROCESS_WELD_VERTICES) {
+        const auto startTime = Timer::now();
+        weldVertices(mesh);
+        DBG "\tWelding took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+    }
+    if ((steps & POST_PROCESS_GENERATE_NORMALS) && !mesh.hasNormals) {
+        const auto startTime = Timer::now();
+        generateNormals(mesh);
+        DBG "\tNormals took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+    }
+    if ((steps & POST_PROCESS_GENERATE_TANGENTS) && !mesh.hasTangents) {
+        const auto startTime = Timer::now();
+        generateTangents(mesh);
+        DBG "\tTangents took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+    }
+    if (steps & POST_PROCESS_SPATIAL_ORDER) {
+#if !defined(NDEBUG) && defined(VERBOSE_PRINTING) // Same as VRB
+        // Vertex fetches, and the simplifier's 4 byte lookup table entries, in index order.
+        // Serial simulations over all indices, so only when asked for.
+        const size_t vertexMissesBefore = countCacheMisses(mesh.indices, sizeof(Vertex));
+        const size_t lutMissesBefore = countCacheMisses(mesh.indices, sizeof(uint32_t));
+#endif
+        const auto startTime = Timer::now();
+        reorderSpatially(mesh);
+        DBG "\tSpatial reordering took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+#if !defined(NDEBUG) && defined(VERBOSE_PRINTING) // Same as VRB
+        VRB "\tSimulated cache misses for vertices: " << vertexMissesBefore << " before, "
+            << countCacheMisses(mesh.indices, sizeof(Vertex)) << " after" ENDL;
+        VRB "\tSimulated cache misses for lookup table entries: " << lutMissesBefore << " before, "
+            << countCacheMisses(mesh.indices, sizeof(uint32_t)) << " after" ENDL;
+#endif
+    }
+    if (steps & POST_PROCESS_LOD_CHAIN) {
+        const auto startTime = Timer::now();
+        generateLodChain(mesh);
+        DBG "\tLOD chain took " << Timer::duration(startTime, Timer::now()) << " seconds" ENDL;
+    }
+    // Before the mesh becomes an entity, so no thread has to compute them while another reads them
+    computeBounds(mesh);
+}
@@ -0,0 +1,65 @@
+//
+// Created by Saman on 30.09.23.
+//
+
+#include "util/range_allocator.h"
+#include "io/printer.h"
+
+RangeAllocator::RangeAllocator(uint32_t capacity) : capacity(capacity), freeSize(capacity) {
+    if (capacity > 0) {
+        this->freeRanges[0] = capacity;
+    }
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size) {
+    if (size == 0) THROW("Can not allocate an empty range");
+
+    for (auto range = this->freeRanges.begin(); range != this->freeRanges.end(); ++range) {
+        if (range->second < size) continue;
+
+        const uint32_t offset = range->first;
+        const uint32_t remaining = range->second - size;
+        this->freeRanges.erase(range);
+        if (remaining > 0) {
+            this->freeRanges[offset + size] = remaining;
+        }
+        this->freeSize -= size;
+        return offset;
+    }
+
+    return INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+    if (offset + size > this->capacity) THROW("Freed range is out of bounds");
+
+    auto next = this->freeRanges.lower_bound(offset);
+    if (next != this->freeRanges.end() && next->first < offset + size) THROW("Freed range overlaps a free range");
+    auto previous = next == this->freeRanges.begin() ? this->freeRanges.end() : std::prev(next);
+    if (previous != this->freeRanges.end() && previous->first + previous->second > offset) {
+        THROW("Freed range overlaps a free range");
+    }
+    this->freeSize += size;
+
+    // Merge with the free range right after this one
+    if (next != this->freeRanges.end() && next->first == offset + size) {
+        size += next->second;
+        this->freeRanges.erase(next);
+    }
+
+    // Merge with the free range right before this one
+    if (previous != this->freeRanges.end() && previous->first + previous->second == offset) {
+        previous->second += size;
+    } else {
+        this->freeRanges[offset] = size;
+    }
+}
+
+uint32_t RangeAllocator::getCapacity() const {
+    return this->capacity;
+}
+
+uint32_t RangeAllocator::getFreeSize() const {
+    return this->freeSize;
+}
@@ -0,0 +1,132 @@
+//
+// Created by Saman on 20.09.23.
+//
+
+#include "util/thread_pool.h"
+#include "io/printer.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+static std::vector<std::thread> workers{};
+static std::deque<std::packaged_task<void()>> tasks{};
+static std::mutex tasksMutex{};
+static std::condition_variable tasksCondition{};
+static bool stopping = false;
+
+// Nested parallelFor calls from a worker run inline, so no worker ever blocks waiting on the queue
+static thread_local bool isWorker = false;
+
+void workerLoop() {
+    isWorker = true;
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(tasksMutex);
+            tasksCondition.wait(lock, [] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return; // Stopping, and all queued work is done
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::create(uint32_t workerCount) {
+    INF "Creating ThreadPool" ENDL;
+
+    if (workerCount == 0) {
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    stopping = false;
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(workerLoop);
+    }
+
+    DBG "Started " << workerCount << " worker threads" ENDL;
+}
+
+void ThreadPool::destroy() {
+    INF "Destroying ThreadPool" ENDL;
+
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        stopping = true;
+    }
+    tasksCondition.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+uint32_t ThreadPool::getThreadCount() {
+    return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packagedTask(std::move(task));
+    auto future = packagedTask.get_future();
+
+    if (workers.empty()) {
+        packagedTask();
+        return future;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.push_back(std::move(packagedTask));
+    }
+    tasksCondition.notify_one();
+    return future;
+}
+
+uint32_t ThreadPool::getChunkCount(size_t count, size_t minChunkSize) {
+    if (isWorker || count == 0) return 1;
+    const size_t chunks = (count + minChunkSize - 1) / std::max<size_t>(minChunkSize, 1);
+    return static_cast<uint32_t>(std::clamp<size_t>(chunks, 1, getThreadCount()));
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t, uint32_t)> &body,
+                             size_t minChunkSize) {
+    const uint32_t chunkCount = getChunkCount(count, minChunkSize);
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    if (chunkCount == 1) {
+        body(0, count, 0);
+        return;
+    }
+
+    std::vector<std::future<void>> futures{};
+    futures.reserve(chunkCount - 1);
+    for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+        const size_t begin = std::min(chunk * chunkSize, count);
+        const size_t end = std::min(begin + chunkSize, count);
+        futures.push_back(submit([&body, begin, end, chunk] { body(begin, end, chunk); }));
+    }
+
+    // The calling thread takes the first chunk instead of idling
+    std::exception_ptr error = nullptr;
+    try {
+        body(0, std::min(chunkSize, count), 0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // The workers reference body, so all of them have to finish before anything is rethrown
+    for (auto &future: futures) {
+        future.wait();
+    }
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+    for (auto &future: futures) {
+        future.get();
+    }
+}